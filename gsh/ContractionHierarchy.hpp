@@ -0,0 +1,271 @@
+#pragma once
+#include "Exception.hpp"
+#include "Heap.hpp"
+#include "TypeDef.hpp"
+#include "Util.hpp"
+#include "Vec.hpp"
+#include <limits>
+#include <tuple>
+#include <utility>
+namespace gsh {
+// Contraction hierarchy of a static weighted graph with nonnegative weights. Vertices are contracted in the order of a lazily updated edge-difference priority, adding a shortcut u -> w for each path u -> v -> w through the contracted vertex v that a hop-limited witness search cannot replace. The upward and downward arcs are stored in CSR form indexed by contraction rank, and a query runs two upward Dijkstra searches with stall-on-demand.
+// The query buffers are kept in the object, so concurrent queries need separate copies.
+template<class W> class ContractionHierarchy {
+public:
+  constexpr static u32 npos = 0xffffffffu;
+  constexpr static W inf = std::numeric_limits<W>::max();
+private:
+  struct Arc {
+    u32 to;
+    W w;
+    u32 mid;  // The contracted vertex a shortcut bypasses, or npos for an original edge.
+  };
+  struct Greater {
+    template<class T> constexpr bool operator()(const T& a, const T& b) const noexcept { return a.first > b.first; }
+  };
+  u32 n_ = 0;
+  Vec<u32> rank_, order_;
+  // up_[up_off_[r], up_off_[r + 1]) are the arcs r -> x with x > r, and dn_[dn_off_[r], dn_off_[r + 1]) the arcs x -> r with x > r (stored with to = x). All ids are ranks.
+  Vec<u32> up_off_, dn_off_;
+  Vec<Arc> up_, dn_;
+  u32 shortcut_count_ = 0;
+  mutable Vec<W> df_, db_;
+  mutable Vec<u32> sf_, sb_, pf_, pb_;
+  mutable u32 epoch_ = 0;
+  mutable Heap<std::pair<W, u32>, Greater> qf_, qb_;
+  constexpr u32 find_mid(u32 x, u32 y) const {
+    if(x < y) {
+      for(u32 i = up_off_[x]; i != up_off_[x + 1]; ++i)
+        if(up_[i].to == y) return up_[i].mid;
+    } else {
+      for(u32 i = dn_off_[y]; i != dn_off_[y + 1]; ++i)
+        if(dn_[i].to == x) return dn_[i].mid;
+    }
+    Unreachable();
+  }
+  // Runs the query on ranks a and b and returns the best distance and the rank where the searches met.
+  constexpr std::pair<W, u32> search(u32 a, u32 b) const {
+    if(++epoch_ == 0) [[unlikely]] {
+      sf_.assign(n_, 0), sb_.assign(n_, 0);
+      epoch_ = 1;
+    }
+    const u32 ep = epoch_;
+    qf_.clear(), qb_.clear();
+    df_[a] = W{}, sf_[a] = ep, pf_[a] = npos, qf_.emplace(W{}, a);
+    db_[b] = W{}, sb_[b] = ep, pb_[b] = npos, qb_.emplace(W{}, b);
+    W best = inf;
+    u32 meet = npos;
+    while(true) {
+      const bool fa = !qf_.empty() && qf_.top().first < best, ba = !qb_.empty() && qb_.top().first < best;
+      if(!fa && !ba) break;
+      const bool forward = fa && (!ba || qf_.top().first <= qb_.top().first);
+      auto& q = forward ? qf_ : qb_;
+      auto& d = forward ? df_ : db_;
+      auto& s = forward ? sf_ : sb_;
+      auto& p = forward ? pf_ : pb_;
+      const auto& od = forward ? db_ : df_;
+      const auto& os = forward ? sb_ : sf_;
+      const auto& rel_off = forward ? up_off_ : dn_off_;
+      const auto& rel = forward ? up_ : dn_;
+      const auto& stall_off = forward ? dn_off_ : up_off_;
+      const auto& stall = forward ? dn_ : up_;
+      const auto [dv, v] = q.top();
+      q.pop();
+      if(dv != d[v]) continue;
+      if(os[v] == ep && dv + od[v] < best) best = dv + od[v], meet = v;
+      // v is stalled if a higher vertex already reached by this search gives a shorter path to it; its arcs cannot lie on a shortest up-down path.
+      bool stalled = false;
+      for(u32 i = stall_off[v]; i != stall_off[v + 1] && !stalled; ++i) stalled = s[stall[i].to] == ep && d[stall[i].to] + stall[i].w < dv;
+      if(stalled) continue;
+      for(u32 i = rel_off[v]; i != rel_off[v + 1]; ++i) {
+        const u32 to = rel[i].to;
+        const W nd = dv + rel[i].w;
+        if(s[to] != ep || nd < d[to]) {
+          d[to] = nd, s[to] = ep, p[to] = v;
+          q.emplace(nd, to);
+        }
+      }
+    }
+    return {best, meet};
+  }
+public:
+  constexpr ContractionHierarchy() = default;
+  // Builds the hierarchy of g (a DirectedGraph or UndirectedGraph). Witness searches relax at most hop_limit arcs per path and settle at most settle_limit vertices; lower limits preprocess faster but add more shortcuts. The searches that only estimate the contraction order are capped at 3 hops and 20 settled vertices.
+  template<class G> constexpr explicit ContractionHierarchy(const G& g, u32 hop_limit = 5, u32 settle_limit = 500) : n_(g.vertex_count()) {
+    const u32 n = n_;
+    Vec<Vec<Arc>> out(n), in(n);
+    auto add = [&](u32 a, u32 b, const W& w, u32 mid) {
+      for(auto& x : out[a]) {
+        if(x.to != b) continue;
+        if(w < x.w) {
+          x.w = w, x.mid = mid;
+          for(auto& y : in[b])
+            if(y.to == a) y.w = w, y.mid = mid;
+        }
+        return;
+      }
+      out[a].push_back({b, w, mid});
+      in[b].push_back({a, w, mid});
+    };
+    for(u32 v = 0; v != n; ++v) {
+      for(const auto& e : g[v]) {
+        const W w = static_cast<W>(e.weight());
+#ifndef NDEBUG
+        if(w < W{}) [[unlikely]]
+          throw Exception("gsh::ContractionHierarchy::ContractionHierarchy / Negative edge weights are not allowed. ( from=", v, ", to=", e.to(), " )");
+#endif
+        if(e.to() != v) add(v, e.to(), w, npos);
+      }
+    }
+    Vec<W> wd(n);
+    Vec<u32> wstamp(n, 0), whop(n), target(n, 0);
+    u32 wep = 0;
+    Heap<std::pair<W, u32>, Greater> wq;
+    // Dijkstra from u that avoids v and stops beyond bound or once the targets (the vertices with target[x] == wep) are settled; afterwards wd[x] is the length of some path u ~> x whenever wstamp[x] == wep.
+    auto witness = [&](u32 u, u32 v, const W& bound, u32 targets, u32 hops, u32 settles) {
+      wq.clear();
+      wd[u] = W{}, wstamp[u] = wep, whop[u] = 0;
+      wq.emplace(W{}, u);
+      for(u32 settled = 0; !wq.empty() && settled != settles; ++settled) {
+        const auto [d, x] = wq.top();
+        wq.pop();
+        if(d != wd[x]) continue;
+        if(bound < d || (target[x] == wep && --targets == 0)) break;
+        if(whop[x] == hops) continue;
+        for(const auto& a : out[x]) {
+          if(a.to == v) continue;
+          const W nd = d + a.w;
+          if(wstamp[a.to] != wep || nd < wd[a.to]) {
+            wd[a.to] = nd, wstamp[a.to] = wep, whop[a.to] = whop[x] + 1;
+            wq.emplace(nd, a.to);
+          }
+        }
+      }
+    };
+    Vec<std::tuple<u32, u32, W>> pending;
+    // The shortcuts needed to contract v; they are added when apply is true, and otherwise only counted with the cheaper estimate searches.
+    // The priority only estimates the shortcut count and is recomputed for every neighbour of each contracted vertex, so its witness searches are capped much lower than the ones that decide which shortcuts are added.
+    const u32 est_hop = hop_limit < 3 ? hop_limit : 3, est_settle = settle_limit < 20 ? settle_limit : 20;
+    auto contract = [&](u32 v, bool apply) {
+      u32 cnt = 0;
+      for(const auto& a : in[v]) {
+        W bound{};
+        u32 targets = 0;
+        ++wep;
+        for(const auto& b : out[v]) {
+          if(b.to == a.to) continue;
+          bound = bound < a.w + b.w ? a.w + b.w : bound;
+          target[b.to] = wep, ++targets;
+        }
+        if(targets == 0) continue;
+        if(apply) witness(a.to, v, bound, targets, hop_limit, settle_limit);
+        else witness(a.to, v, bound, targets, est_hop, est_settle);
+        for(const auto& b : out[v]) {
+          if(b.to == a.to) continue;
+          const W via = a.w + b.w;
+          if(wstamp[b.to] == wep && wd[b.to] <= via) continue;
+          ++cnt;
+          if(apply) pending.emplace_back(a.to, b.to, via);
+        }
+      }
+      if(apply) {
+        for(const auto& [x, y, w] : pending) add(x, y, w, v);
+        shortcut_count_ += pending.size();
+        pending.clear();
+      }
+      return cnt;
+    };
+    // Twice the edge difference (with shortcuts counted double), plus the number of contracted neighbours and the depth in the hierarchy so that contractions spread evenly over the graph.
+    Vec<u32> deleted(n, 0), level(n, 0), seen(n, npos);
+    auto priority = [&](u32 v) { return 2 * (2 * static_cast<i64>(contract(v, false)) - static_cast<i64>(in[v].size() + out[v].size())) + deleted[v] + level[v]; };
+    Vec<i64> pr(n);
+    Heap<std::pair<i64, u32>, Greater> pq;
+    pq.reserve(n);
+    for(u32 v = 0; v != n; ++v) pr[v] = priority(v), pq.emplace(pr[v], v);
+    rank_.assign(n, npos);
+    order_.reserve(n);
+    up_off_.reserve(n + 1), dn_off_.reserve(n + 1);
+    up_off_.push_back(0), dn_off_.push_back(0);
+    auto erase = [](Vec<Arc>& list, u32 v) {
+      for(u32 i = 0; i != list.size(); ++i) {
+        if(list[i].to != v) continue;
+        list[i] = list.back();
+        list.pop_back();
+        return;
+      }
+    };
+    while(!pq.empty()) {
+      const auto [p, v] = pq.top();
+      pq.pop();
+      if(rank_[v] != npos || p != pr[v]) continue;
+      // Lazy update: v is contracted only if its recomputed priority is still no larger than the smallest stored one.
+      const i64 np = priority(v);
+      if(!pq.empty() && np > pq.top().first) {
+        pr[v] = np;
+        pq.emplace(np, v);
+        continue;
+      }
+      rank_[v] = order_.size();
+      order_.push_back(v);
+      contract(v, true);
+      for(const auto& a : out[v]) up_.push_back(a), erase(in[a.to], v);
+      for(const auto& a : in[v]) dn_.push_back(a), erase(out[a.to], v);
+      up_off_.push_back(up_.size()), dn_off_.push_back(dn_.size());
+      // A neighbour joined by arcs in both directions is updated once.
+      auto update = [&](u32 x) {
+        if(seen[x] == v) return;
+        seen[x] = v;
+        ++deleted[x];
+        level[x] = level[x] > level[v] + 1 ? level[x] : level[v] + 1;
+        pr[x] = priority(x);
+        pq.emplace(pr[x], x);
+      };
+      for(const auto& a : out[v]) update(a.to);
+      for(const auto& a : in[v]) update(a.to);
+      out[v] = Vec<Arc>(), in[v] = Vec<Arc>();
+    }
+    for(auto& a : up_) a.to = rank_[a.to], a.mid = a.mid == npos ? npos : rank_[a.mid];
+    for(auto& a : dn_) a.to = rank_[a.to], a.mid = a.mid == npos ? npos : rank_[a.mid];
+    df_.resize(n), db_.resize(n), pf_.resize(n), pb_.resize(n);
+    sf_.assign(n, 0), sb_.assign(n, 0);
+  }
+  constexpr u32 vertex_count() const noexcept { return n_; }
+  constexpr u32 shortcut_count() const noexcept { return shortcut_count_; }
+  // The position of v in the contraction order.
+  constexpr u32 rank(u32 v) const { return rank_[v]; }
+  // The distance from s to t, or inf if t is unreachable.
+  constexpr W dist(u32 s, u32 t) const {
+#ifndef NDEBUG
+    if(s >= n_ || t >= n_) [[unlikely]]
+      throw Exception("gsh::ContractionHierarchy::dist / The index is out of range. ( s=", s, ", t=", t, ", n=", n_, " )");
+#endif
+    return search(rank_[s], rank_[t]).first;
+  }
+  // The vertices of a shortest path from s to t with the shortcuts unpacked, or an empty Vec if t is unreachable.
+  constexpr Vec<u32> path(u32 s, u32 t) const {
+#ifndef NDEBUG
+    if(s >= n_ || t >= n_) [[unlikely]]
+      throw Exception("gsh::ContractionHierarchy::path / The index is out of range. ( s=", s, ", t=", t, ", n=", n_, " )");
+#endif
+    const auto [best, meet] = search(rank_[s], rank_[t]);
+    Vec<u32> res;
+    if(best == inf) return res;
+    Vec<u32> up;
+    for(u32 x = meet; x != npos; x = pf_[x]) up.push_back(x);
+    up.reverse();
+    for(u32 x = pb_[meet]; x != npos; x = pb_[x]) up.push_back(x);
+    res.push_back(order_[up[0]]);
+    Vec<std::pair<u32, u32>> st;
+    for(u32 i = up.size() - 1; i != 0; --i) st.emplace_back(up[i - 1], up[i]);
+    while(!st.empty()) {
+      const auto [x, y] = st.back();
+      st.pop_back();
+      const u32 m = find_mid(x, y);
+      if(m == npos) res.push_back(order_[y]);
+      else st.emplace_back(m, y), st.emplace_back(x, m);
+    }
+    return res;
+  }
+};
+template<class G, class... Args> ContractionHierarchy(const G&, Args...) -> ContractionHierarchy<typename G::weight_type>;
+}
@@ -0,0 +1,598 @@
+#pragma once
+#include "Exception.hpp"
+#include "Modint.hpp"
+#include "TypeDef.hpp"
+#include "Util.hpp"
+#include "Vec.hpp"
+#include "internal/UtilMacro.hpp"
+#include <bit>
+#include <concepts>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define GSH_INTERNAL_CONVOLUTION_HAS_AVX2
+#endif
+namespace gsh {
+namespace internal {
+// Montgomery arithmetic over R = 2^32 for an odd modulus below 2^30. Only the twiddle factors are kept in Montgomery form, so mul(x, w * R) returns the plain product x * w.
+template<u32 mod_> class NttMontgomery {
+  static_assert(mod_ % 2 == 1 && mod_ < (1u << 30), "gsh::internal::NttMontgomery / The modulus must be odd and less than 2^30.");
+  constexpr static u32 calc_ninv() {
+    u32 x = mod_;
+    for(u32 i = 0; i != 4; ++i) x *= 2 - mod_ * x;
+    return -x;
+  }
+public:
+  constexpr static u32 mod = mod_, ninv = calc_ninv(), r2 = static_cast<u32>(-static_cast<u64>(mod_) % mod_);
+  GSH_INTERNAL_INLINE constexpr static u32 reduce(u64 t) {
+    const u32 r = (t + static_cast<u64>(static_cast<u32>(t) * ninv) * mod_) >> 32;
+    return r >= mod_ ? r - mod_ : r;
+  }
+  GSH_INTERNAL_INLINE constexpr static u32 mul(u32 x, u32 y) { return reduce(static_cast<u64>(x) * y); }
+  GSH_INTERNAL_INLINE constexpr static u32 add(u32 x, u32 y) {
+    const u32 r = x + y;
+    return r >= mod_ ? r - mod_ : r;
+  }
+  GSH_INTERNAL_INLINE constexpr static u32 sub(u32 x, u32 y) {
+    const u32 r = x - y;
+    return x < y ? r + mod_ : r;
+  }
+  constexpr static u32 pow(u32 x, u32 e) {
+    u64 res = 1, b = x;
+    for(; e != 0; e >>= 1, b = b * b % mod_)
+      if(e & 1) res = res * b % mod_;
+    return res;
+  }
+  constexpr static u32 to_mont(u32 x) { return (static_cast<u64>(x) << 32) % mod_; }
+};
+// Roots of unity in Montgomery form. rate3[i] moves the twiddle of radix-4 block s to block s + 1 when s has i trailing ones; see NttTwiddles.
+template<u32 mod_> constexpr auto NttTable = [] {
+  using M = NttMontgomery<mod_>;
+  constexpr u32 rank2 = std::countr_zero(mod_ - 1);
+  struct {
+    u32 g, rank;
+    u32 root[rank2 + 1], iroot[rank2 + 1];
+    u32 rate3[rank2 + 1], irate3[rank2 + 1];
+  } res{};
+  u32 g = 2;
+  for(;; ++g) {
+    bool ok = true;
+    u32 m = mod_ - 1;
+    for(u32 p = 2; p * p <= m; ++p) {
+      if(m % p != 0) continue;
+      ok &= M::pow(g, (mod_ - 1) / p) != 1;
+      while(m % p == 0) m /= p;
+    }
+    if(m != 1) ok &= M::pow(g, (mod_ - 1) / m) != 1;
+    if(ok) break;
+  }
+  res.g = g, res.rank = rank2;
+  u32 root[rank2 + 1], iroot[rank2 + 1];
+  root[rank2] = M::pow(g, (mod_ - 1) >> rank2);
+  iroot[rank2] = M::pow(root[rank2], mod_ - 2);
+  for(u32 i = rank2; i-- != 0;) root[i] = static_cast<u64>(root[i + 1]) * root[i + 1] % mod_, iroot[i] = static_cast<u64>(iroot[i + 1]) * iroot[i + 1] % mod_;
+  u64 prod = 1, iprod = 1;
+  for(u32 i = 0; i + 3 <= rank2; ++i) {
+    res.rate3[i] = M::to_mont(root[i + 3] * prod % mod_), res.irate3[i] = M::to_mont(iroot[i + 3] * iprod % mod_);
+    prod = prod * iroot[i + 3] % mod_, iprod = iprod * root[i + 3] % mod_;
+  }
+  for(u32 i = 0; i <= rank2; ++i) res.root[i] = M::to_mont(root[i]), res.iroot[i] = M::to_mont(iroot[i]);
+  return res;
+}();
+template<class T, u32 mod_> struct ConvolutionResult {
+  using type = Vec<u32>;
+  constexpr static void check() noexcept {}
+  GSH_INTERNAL_INLINE constexpr static u32 get(const T& x) {
+    if constexpr(std::is_signed_v<T>) {
+      // Negated in unsigned arithmetic, which is also defined for the minimum value.
+      using U = std::make_unsigned_t<T>;
+      const u32 r = x < 0 ? static_cast<u32>((U(0) - static_cast<U>(x)) % mod_) : static_cast<u32>(x % mod_);
+      return x < 0 && r != 0 ? mod_ - r : r;
+    } else return static_cast<u32>(x % mod_);
+  }
+  GSH_INTERNAL_INLINE constexpr static u32 make(u32 x) { return x; }
+};
+// Modints are taken by value, so their modulus has to be mod_.
+template<class T, u32 id, bool IsThreadLocal, u32 mod_> struct ConvolutionResult<ModintInterface<T, id, IsThreadLocal>, mod_> {
+  using mint = ModintInterface<T, id, IsThreadLocal>;
+  using type = Vec<mint>;
+  constexpr static void check() {
+    if constexpr(mint::is_static_mod) static_assert(mint::mod() == mod_, "gsh::Convolution / The modulus of the modint must be the modulus of the convolution.");
+    else if(mint::mod() != mod_) [[unlikely]]
+      throw Exception("gsh::Convolution / The modulus of the modint must be the modulus of the convolution. ( modint=", mint::mod(), ", convolution=", mod_, " )");
+  }
+  GSH_INTERNAL_INLINE constexpr static u32 get(const mint& x) { return x.val(); }
+  GSH_INTERNAL_INLINE constexpr static mint make(u32 x) { return mint::raw(x); }
+};
+// Twiddles of the butterfly blocks, shared by all passes: block s of any radix-4 pass uses r1[s], r2[s] = r1[s]^2, r3[s] = r1[s]^3, and block s of the radix-2 pass uses r2[s]. ir* are the inverse counterparts. Grown on demand, one copy per thread.
+template<u32 mod_> class NttTwiddles {
+  using M = NttMontgomery<mod_>;
+  Vec<u32> tw[6];
+  void extend(Vec<u32>* t, const u32* rate, u32 n) {
+    u32 s = t[0].size();
+    if(s >= n) return;
+    for(u32 i = 0; i != 3; ++i) t[i].resize(n);
+    if(s == 0) t[0][0] = t[1][0] = t[2][0] = M::to_mont(1), s = 1;
+    for(; s != n; ++s) {
+      const u32 r = M::mul(t[0][s - 1], rate[std::countr_one(s - 1)]);
+      t[0][s] = r, t[1][s] = M::mul(r, r), t[2][s] = M::mul(t[1][s], r);
+    }
+  }
+public:
+  // Makes the forward tables cover 2^(h-1) blocks and the inverse ones 2^(h-2) blocks.
+  void reserve(u32 h) {
+    extend(tw, NttTable<mod_>.rate3, h == 0 ? 1 : 1u << (h - 1));
+    extend(tw + 3, NttTable<mod_>.irate3, h < 2 ? 1 : 1u << (h - 2));
+  }
+  const u32* operator[](u32 i) const { return tw[i].data(); }
+  static NttTwiddles& get() {
+    thread_local NttTwiddles res;
+    return res;
+  }
+};
+// One butterfly pass over cnt consecutive blocks. x points at the first block, p is the distance between the legs, r1..r3 are the twiddles of the blocks, and first tells that the first block has unit twiddles.
+template<u32 mod_> struct NttScalarKernel {
+  using M = NttMontgomery<mod_>;
+  static void fwd2(u32* x, u32 cnt, const u32* r) {
+    for(u32 b = 0; b != cnt; ++b, x += 2) {
+      const u32 l = x[0], t = M::mul(x[1], r[b]);
+      x[0] = M::add(l, t), x[1] = M::sub(l, t);
+    }
+  }
+  static void fwd4(u32* x, u32 p, u32 cnt, const u32* r1, const u32* r2, const u32* r3, bool first) {
+    const u32 imag = NttTable<mod_>.root[2];
+    for(u32 b = 0; b != cnt; ++b, x += 4 * p) {
+      const bool f = first && b == 0;
+      for(u32 i = 0; i != p; ++i) {
+        const u32 a0 = x[i], a1 = f ? x[i + p] : M::mul(x[i + p], r1[b]), a2 = f ? x[i + 2 * p] : M::mul(x[i + 2 * p], r2[b]), a3 = f ? x[i + 3 * p] : M::mul(x[i + 3 * p], r3[b]);
+        const u32 t0 = M::add(a0, a2), t1 = M::sub(a0, a2), t2 = M::add(a1, a3), t3 = M::mul(M::sub(a1, a3), imag);
+        x[i] = M::add(t0, t2), x[i + p] = M::sub(t0, t2), x[i + 2 * p] = M::add(t1, t3), x[i + 3 * p] = M::sub(t1, t3);
+      }
+    }
+  }
+  static void inv2(u32* x, u32 p) {
+    for(u32 i = 0; i != p; ++i) {
+      const u32 l = x[i], r = x[i + p];
+      x[i] = M::add(l, r), x[i + p] = M::sub(l, r);
+    }
+  }
+  static void inv4(u32* x, u32 p, u32 cnt, const u32* r1, const u32* r2, const u32* r3, bool first) {
+    const u32 iimag = NttTable<mod_>.iroot[2];
+    for(u32 b = 0; b != cnt; ++b, x += 4 * p) {
+      const bool f = first && b == 0;
+      for(u32 i = 0; i != p; ++i) {
+        const u32 a0 = x[i], a1 = x[i + p], a2 = x[i + 2 * p], a3 = x[i + 3 * p];
+        const u32 t0 = M::add(a0, a1), t1 = M::sub(a0, a1), t2 = M::add(a2, a3), t3 = M::mul(M::sub(a2, a3), iimag);
+        const u32 b1 = M::add(t1, t3), b2 = M::sub(t0, t2), b3 = M::sub(t1, t3);
+        x[i] = M::add(t0, t2), x[i + p] = f ? b1 : M::mul(b1, r1[b]), x[i + 2 * p] = f ? b2 : M::mul(b2, r2[b]), x[i + 3 * p] = f ? b3 : M::mul(b3, r3[b]);
+      }
+    }
+  }
+  static void dot(u32* x, const u32* y, u32 n) {
+    for(u32 i = 0; i != n; ++i) x[i] = M::mul(x[i], y[i]);
+  }
+  static void scale(u32* x, u32 n, u32 c) {
+    for(u32 i = 0; i != n; ++i) x[i] = M::mul(x[i], c);
+  }
+  // x[i] = (x[i] - y[i]) * c for a Montgomery-form c. k is a multiple of mod not less than any y[i], so that x[i] + k - y[i] stays nonnegative.
+  static void garner(u32* x, const u32* y, u32 n, u32 k, u32 c) {
+    for(u32 i = 0; i != n; ++i) x[i] = M::mul(x[i] + k - y[i], c);
+  }
+};
+#ifdef GSH_INTERNAL_CONVOLUTION_HAS_AVX2
+// 8-lane version of NttMontgomery. Lanes are reduced to [0, mod) with min_epu32(r, r - mod), which relies on r - mod wrapping around when r < mod.
+template<u32 mod_> struct NttMontgomeryAVX2 {
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static __m256i mul(__m256i x, __m256i y) {
+    const __m256i m = _mm256_set1_epi32(mod_), ninv = _mm256_set1_epi32(NttMontgomery<mod_>::ninv);
+    const __m256i pe = _mm256_mul_epu32(x, y), po = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(y, 32));
+    const __m256i re = _mm256_add_epi64(pe, _mm256_mul_epu32(_mm256_mul_epu32(pe, ninv), m)), ro = _mm256_add_epi64(po, _mm256_mul_epu32(_mm256_mul_epu32(po, ninv), m));
+    const __m256i r = _mm256_blend_epi32(_mm256_srli_epi64(re, 32), ro, 0b10101010);
+    return _mm256_min_epu32(r, _mm256_sub_epi32(r, m));
+  }
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static __m256i add(__m256i x, __m256i y) {
+    const __m256i r = _mm256_add_epi32(x, y);
+    return _mm256_min_epu32(r, _mm256_sub_epi32(r, _mm256_set1_epi32(mod_)));
+  }
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static __m256i sub(__m256i x, __m256i y) {
+    const __m256i r = _mm256_sub_epi32(x, y);
+    return _mm256_min_epu32(r, _mm256_add_epi32(r, _mm256_set1_epi32(mod_)));
+  }
+};
+// Same interface as NttScalarKernel. Legs of at least 8 elements are processed directly; passes with p = 4, 2, 1 gather the legs of 2, 4 or 8 blocks into full vectors with in-register transposes.
+template<u32 mod_> struct NttAVX2Kernel {
+  using S = NttScalarKernel<mod_>;
+  using V = NttMontgomeryAVX2<mod_>;
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static __m256i load(const u32* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static void store(u32* p, __m256i x) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x); }
+  // Twiddles of 8 consecutive blocks, permuted to the lane order produced by the transposes.
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static __m256i spread(const u32* r, __m256i idx) { return _mm256_permutevar8x32_epi32(load(r), idx); }
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static __m256i spread4(const u32* r, __m256i idx) { return _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(r))), idx); }
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static void fwd4_core(__m256i& a0, __m256i& a1, __m256i& a2, __m256i& a3, __m256i imag) {
+    const __m256i t0 = V::add(a0, a2), t1 = V::sub(a0, a2), t2 = V::add(a1, a3), t3 = V::mul(V::sub(a1, a3), imag);
+    a0 = V::add(t0, t2), a1 = V::sub(t0, t2), a2 = V::add(t1, t3), a3 = V::sub(t1, t3);
+  }
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static void inv4_core(__m256i& a0, __m256i& a1, __m256i& a2, __m256i& a3, __m256i iimag) {
+    const __m256i t0 = V::add(a0, a1), t1 = V::sub(a0, a1), t2 = V::add(a2, a3), t3 = V::mul(V::sub(a2, a3), iimag);
+    a0 = V::add(t0, t2), a1 = V::add(t1, t3), a2 = V::sub(t0, t2), a3 = V::sub(t1, t3);
+  }
+  // 4x4 transposes of the 32 elements at x: by 64-bit units for p = 2 and by 32-bit units inside each 128-bit lane for p = 1. Both are involutions.
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static void transpose64(__m256i& a0, __m256i& a1, __m256i& a2, __m256i& a3) {
+    const __m256i t0 = _mm256_unpacklo_epi64(a0, a1), t1 = _mm256_unpackhi_epi64(a0, a1), t2 = _mm256_unpacklo_epi64(a2, a3), t3 = _mm256_unpackhi_epi64(a2, a3);
+    a0 = _mm256_permute2x128_si256(t0, t2, 0x20), a1 = _mm256_permute2x128_si256(t1, t3, 0x20), a2 = _mm256_permute2x128_si256(t0, t2, 0x31), a3 = _mm256_permute2x128_si256(t1, t3, 0x31);
+  }
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static void transpose32(__m256i& a0, __m256i& a1, __m256i& a2, __m256i& a3) {
+    const __m256i t0 = _mm256_unpacklo_epi32(a0, a1), t1 = _mm256_unpackhi_epi32(a0, a1), t2 = _mm256_unpacklo_epi32(a2, a3), t3 = _mm256_unpackhi_epi32(a2, a3);
+    a0 = _mm256_unpacklo_epi64(t0, t2), a1 = _mm256_unpackhi_epi64(t0, t2), a2 = _mm256_unpacklo_epi64(t1, t3), a3 = _mm256_unpackhi_epi64(t1, t3);
+  }
+  __attribute__((target("avx2"))) static void fwd2(u32* x, u32 cnt, const u32* r) {
+    if(cnt % 8 != 0) return S::fwd2(x, cnt, r);
+    const __m256i idx = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    for(u32 b = 0; b != cnt; b += 8, x += 16) {
+      const __m256i v0 = load(x), v1 = load(x + 8);
+      const __m256i l = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(v0), _mm256_castsi256_ps(v1), 0x88));
+      const __m256i t = V::mul(_mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(v0), _mm256_castsi256_ps(v1), 0xdd)), spread(r + b, idx));
+      const __m256i e = V::add(l, t), o = V::sub(l, t);
+      store(x, _mm256_unpacklo_epi32(e, o)), store(x + 8, _mm256_unpackhi_epi32(e, o));
+    }
+  }
+  __attribute__((target("avx2"))) static void fwd4(u32* x, u32 p, u32 cnt, const u32* r1, const u32* r2, const u32* r3, bool first) {
+    const __m256i imag = _mm256_set1_epi32(NttTable<mod_>.root[2]);
+    if(p >= 8) {
+      for(u32 b = 0; b != cnt; ++b, x += 4 * p) {
+        const bool f = first && b == 0;
+        const __m256i w1 = _mm256_set1_epi32(r1[b]), w2 = _mm256_set1_epi32(r2[b]), w3 = _mm256_set1_epi32(r3[b]);
+        for(u32 i = 0; i != p; i += 8) {
+          __m256i a0 = load(x + i), a1 = load(x + i + p), a2 = load(x + i + 2 * p), a3 = load(x + i + 3 * p);
+          if(!f) a1 = V::mul(a1, w1), a2 = V::mul(a2, w2), a3 = V::mul(a3, w3);
+          fwd4_core(a0, a1, a2, a3, imag);
+          store(x + i, a0), store(x + i + p, a1), store(x + i + 2 * p, a2), store(x + i + 3 * p, a3);
+        }
+      }
+    } else if(p == 4 && cnt % 2 == 0) {
+      const __m256i idx = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+      for(u32 b = 0; b != cnt; b += 2, x += 32) {
+        const __m256i v0 = load(x), v1 = load(x + 8), v2 = load(x + 16), v3 = load(x + 24);
+        __m256i a0 = _mm256_permute2x128_si256(v0, v2, 0x20), a1 = _mm256_permute2x128_si256(v0, v2, 0x31), a2 = _mm256_permute2x128_si256(v1, v3, 0x20), a3 = _mm256_permute2x128_si256(v1, v3, 0x31);
+        a1 = V::mul(a1, _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r1 + b))), idx));
+        a2 = V::mul(a2, _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r2 + b))), idx));
+        a3 = V::mul(a3, _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r3 + b))), idx));
+        fwd4_core(a0, a1, a2, a3, imag);
+        store(x, _mm256_permute2x128_si256(a0, a1, 0x20)), store(x + 8, _mm256_permute2x128_si256(a2, a3, 0x20)), store(x + 16, _mm256_permute2x128_si256(a0, a1, 0x31)), store(x + 24, _mm256_permute2x128_si256(a2, a3, 0x31));
+      }
+    } else if(p == 2 && cnt % 4 == 0) {
+      const __m256i idx = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+      for(u32 b = 0; b != cnt; b += 4, x += 32) {
+        __m256i a0 = load(x), a1 = load(x + 8), a2 = load(x + 16), a3 = load(x + 24);
+        transpose64(a0, a1, a2, a3);
+        a1 = V::mul(a1, spread4(r1 + b, idx)), a2 = V::mul(a2, spread4(r2 + b, idx)), a3 = V::mul(a3, spread4(r3 + b, idx));
+        fwd4_core(a0, a1, a2, a3, imag);
+        transpose64(a0, a1, a2, a3);
+        store(x, a0), store(x + 8, a1), store(x + 16, a2), store(x + 24, a3);
+      }
+    } else if(p == 1 && cnt % 8 == 0) {
+      const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+      for(u32 b = 0; b != cnt; b += 8, x += 32) {
+        __m256i a0 = load(x), a1 = load(x + 8), a2 = load(x + 16), a3 = load(x + 24);
+        transpose32(a0, a1, a2, a3);
+        a1 = V::mul(a1, spread(r1 + b, idx)), a2 = V::mul(a2, spread(r2 + b, idx)), a3 = V::mul(a3, spread(r3 + b, idx));
+        fwd4_core(a0, a1, a2, a3, imag);
+        transpose32(a0, a1, a2, a3);
+        store(x, a0), store(x + 8, a1), store(x + 16, a2), store(x + 24, a3);
+      }
+    } else S::fwd4(x, p, cnt, r1, r2, r3, first);
+  }
+  __attribute__((target("avx2"))) static void inv2(u32* x, u32 p) {
+    if(p < 8) return S::inv2(x, p);
+    for(u32 i = 0; i != p; i += 8) {
+      const __m256i a = load(x + i), b = load(x + i + p);
+      store(x + i, V::add(a, b)), store(x + i + p, V::sub(a, b));
+    }
+  }
+  __attribute__((target("avx2"))) static void inv4(u32* x, u32 p, u32 cnt, const u32* r1, const u32* r2, const u32* r3, bool first) {
+    const __m256i iimag = _mm256_set1_epi32(NttTable<mod_>.iroot[2]);
+    if(p >= 8) {
+      for(u32 b = 0; b != cnt; ++b, x += 4 * p) {
+        const bool f = first && b == 0;
+        const __m256i w1 = _mm256_set1_epi32(r1[b]), w2 = _mm256_set1_epi32(r2[b]), w3 = _mm256_set1_epi32(r3[b]);
+        for(u32 i = 0; i != p; i += 8) {
+          __m256i a0 = load(x + i), a1 = load(x + i + p), a2 = load(x + i + 2 * p), a3 = load(x + i + 3 * p);
+          inv4_core(a0, a1, a2, a3, iimag);
+          if(!f) a1 = V::mul(a1, w1), a2 = V::mul(a2, w2), a3 = V::mul(a3, w3);
+          store(x + i, a0), store(x + i + p, a1), store(x + i + 2 * p, a2), store(x + i + 3 * p, a3);
+        }
+      }
+    } else if(p == 4 && cnt % 2 == 0) {
+      const __m256i idx = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+      for(u32 b = 0; b != cnt; b += 2, x += 32) {
+        const __m256i v0 = load(x), v1 = load(x + 8), v2 = load(x + 16), v3 = load(x + 24);
+        __m256i a0 = _mm256_permute2x128_si256(v0, v2, 0x20), a1 = _mm256_permute2x128_si256(v0, v2, 0x31), a2 = _mm256_permute2x128_si256(v1, v3, 0x20), a3 = _mm256_permute2x128_si256(v1, v3, 0x31);
+        inv4_core(a0, a1, a2, a3, iimag);
+        a1 = V::mul(a1, _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r1 + b))), idx));
+        a2 = V::mul(a2, _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r2 + b))), idx));
+        a3 = V::mul(a3, _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r3 + b))), idx));
+        store(x, _mm256_permute2x128_si256(a0, a1, 0x20)), store(x + 8, _mm256_permute2x128_si256(a2, a3, 0x20)), store(x + 16, _mm256_permute2x128_si256(a0, a1, 0x31)), store(x + 24, _mm256_permute2x128_si256(a2, a3, 0x31));
+      }
+    } else if(p == 2 && cnt % 4 == 0) {
+      const __m256i idx = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+      for(u32 b = 0; b != cnt; b += 4, x += 32) {
+        __m256i a0 = load(x), a1 = load(x + 8), a2 = load(x + 16), a3 = load(x + 24);
+        transpose64(a0, a1, a2, a3);
+        inv4_core(a0, a1, a2, a3, iimag);
+        a1 = V::mul(a1, spread4(r1 + b, idx)), a2 = V::mul(a2, spread4(r2 + b, idx)), a3 = V::mul(a3, spread4(r3 + b, idx));
+        transpose64(a0, a1, a2, a3);
+        store(x, a0), store(x + 8, a1), store(x + 16, a2), store(x + 24, a3);
+      }
+    } else if(p == 1 && cnt % 8 == 0) {
+      const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+      for(u32 b = 0; b != cnt; b += 8, x += 32) {
+        __m256i a0 = load(x), a1 = load(x + 8), a2 = load(x + 16), a3 = load(x + 24);
+        transpose32(a0, a1, a2, a3);
+        inv4_core(a0, a1, a2, a3, iimag);
+        a1 = V::mul(a1, spread(r1 + b, idx)), a2 = V::mul(a2, spread(r2 + b, idx)), a3 = V::mul(a3, spread(r3 + b, idx));
+        transpose32(a0, a1, a2, a3);
+        store(x, a0), store(x + 8, a1), store(x + 16, a2), store(x + 24, a3);
+      }
+    } else S::inv4(x, p, cnt, r1, r2, r3, first);
+  }
+  __attribute__((target("avx2"))) static void dot(u32* x, const u32* y, u32 n) {
+    u32 i = 0;
+    for(; i + 8 <= n; i += 8) store(x + i, V::mul(load(x + i), load(y + i)));
+    S::dot(x + i, y + i, n - i);
+  }
+  __attribute__((target("avx2"))) static void scale(u32* x, u32 n, u32 c) {
+    const __m256i w = _mm256_set1_epi32(c);
+    u32 i = 0;
+    for(; i + 8 <= n; i += 8) store(x + i, V::mul(load(x + i), w));
+    S::scale(x + i, n - i, c);
+  }
+  __attribute__((target("avx2"))) static void garner(u32* x, const u32* y, u32 n, u32 k, u32 c) {
+    const __m256i w = _mm256_set1_epi32(c), kv = _mm256_set1_epi32(k);
+    u32 i = 0;
+    for(; i + 8 <= n; i += 8) store(x + i, V::mul(_mm256_sub_epi32(_mm256_add_epi32(load(x + i), kv), load(y + i)), w));
+    S::garner(x + i, y + i, n - i, k, c);
+  }
+};
+#endif
+}
+// Convolution modulo an NTT-friendly prime (mod = c * 2^k + 1 < 2^30).
+// transform() is a decimation-in-frequency radix-4 NTT that leaves its output in bit-reversed order, and inverse_transform() is the matching decimation-in-time transform that takes bit-reversed input, so no permutation pass is needed between them. On CPUs with AVX2 the butterflies run on 8 lanes.
+template<u32 mod_ = 998244353> class Convolution {
+  using M = internal::NttMontgomery<mod_>;
+  constexpr static auto& table = internal::NttTable<mod_>;
+  // Blocks of at most 2^CacheBits elements are finished pass by pass; larger ones are split depth-first so that the later passes run in cache.
+  constexpr static u32 CacheBits = 14;
+  // x is block s of pass len (a block of 2^(h-len) elements).
+  template<class K> static void forward_rec(u32* x, u32 h, u32 len, u32 s, const internal::NttTwiddles<mod_>& tw) {
+    if(h - len <= CacheBits) {
+      for(u32 l = len; l < h;) {
+        const u32 cnt = 1u << (l - len), s0 = s << (l - len);
+        if(h - l == 1) {
+          K::fwd2(x, cnt, tw[1] + s0);
+          ++l;
+        } else {
+          K::fwd4(x, 1u << (h - l - 2), cnt, tw[0] + s0, tw[1] + s0, tw[2] + s0, s0 == 0);
+          l += 2;
+        }
+      }
+      return;
+    }
+    const u32 p = 1u << (h - len - 2);
+    K::fwd4(x, p, 1, tw[0] + s, tw[1] + s, tw[2] + s, s == 0);
+    for(u32 t = 0; t != 4; ++t) forward_rec<K>(x + t * p, h, len + 2, 4 * s + t, tw);
+  }
+  // x is block s of inverse pass len (a block of 2^(h-len+2) elements); all passes from h down to len are applied to it.
+  template<class K> static void backward_rec(u32* x, u32 h, u32 len, u32 s, const internal::NttTwiddles<mod_>& tw) {
+    if(h - len + 2 <= CacheBits) {
+      for(u32 l = (h - len) % 2 == 0 ? h : h - 1; l >= len; l -= 2) {
+        const u32 cnt = 1u << (l - len), s0 = s << (l - len);
+        K::inv4(x, 1u << (h - l), cnt, tw[3] + s0, tw[4] + s0, tw[5] + s0, s0 == 0);
+      }
+      return;
+    }
+    const u32 p = 1u << (h - len);
+    for(u32 t = 0; t != 4; ++t) backward_rec<K>(x + t * p, h, len + 2, 4 * s + t, tw);
+    K::inv4(x, p, 1, tw[3] + s, tw[4] + s, tw[5] + s, s == 0);
+  }
+  template<class K> static void forward(u32* a, u32 n) {
+    const u32 h = std::countr_zero(n);
+    if(h == 0) return;
+    auto& tw = internal::NttTwiddles<mod_>::get();
+    tw.reserve(h);
+    forward_rec<K>(a, h, 0, 0, tw);
+  }
+  template<class K> static void backward(u32* a, u32 n) {
+    const u32 h = std::countr_zero(n);
+    if(h == 0) return;
+    auto& tw = internal::NttTwiddles<mod_>::get();
+    tw.reserve(h);
+    if(h % 2 == 0) return backward_rec<K>(a, h, 2, 0, tw);
+    if(h > 1) backward_rec<K>(a, h, 3, 0, tw), backward_rec<K>(a + (n >> 1), h, 3, 1, tw);
+    K::inv2(a, n >> 1);
+  }
+  template<class F> static void dispatch(F&& f) {
+#ifdef GSH_INTERNAL_CONVOLUTION_HAS_AVX2
+    if(internal::HasAVX2()) return f(internal::NttAVX2Kernel<mod_>());
+#endif
+    f(internal::NttScalarKernel<mod_>());
+  }
+public:
+  constexpr static u32 mod() noexcept { return mod_; }
+  constexpr static u32 max_size() noexcept { return 1u << table.rank; }
+  constexpr static u32 primitive_root() noexcept { return table.g; }
+  // In-place forward transform of n = 2^k residues in [0, mod).
+  static void transform(u32* a, u32 n) {
+    dispatch([&]<class K>(K) { forward<K>(a, n); });
+  }
+  // In-place inverse of transform(), without the division by n.
+  static void inverse_transform(u32* a, u32 n) {
+    dispatch([&]<class K>(K) { backward<K>(a, n); });
+  }
+  // Replaces x with the residues of the convolution of x and y, whose elements must be in [0, mod). y is clobbered.
+  static void convolve(Vec<u32>& x, Vec<u32>& y) {
+    const u32 n = x.size(), m = y.size();
+    if(n == 0 || m == 0) return x.clear();
+    const u32 len = n + m - 1;
+    if((n < m ? n : m) <= 40) {
+      Vec<u32> z(len);
+      for(u32 i = 0; i != n; ++i) {
+        const u32 xi = M::to_mont(x[i]);
+        for(u32 j = 0; j != m; ++j) z[i + j] = M::add(z[i + j], M::mul(y[j], xi));
+      }
+      x = std::move(z);
+      return;
+    }
+    const u32 sz = std::bit_ceil(len);
+    if(sz > max_size()) [[unlikely]]
+      throw Exception("gsh::Convolution::convolve / The result is too long for this modulus. ( len=", len, ", max=", max_size(), " )");
+    x.resize(sz), y.resize(sz);
+    // mul() divides by R, which is folded into the final scaling together with 1/sz.
+    const u32 scale = M::mul(M::r2, M::mul(M::pow(sz, mod_ - 2), M::r2));
+    dispatch([&]<class K>(K) {
+      forward<K>(x.data(), sz);
+      forward<K>(y.data(), sz);
+      K::dot(x.data(), y.data(), sz);
+      backward<K>(x.data(), sz);
+      K::scale(x.data(), len, scale);
+    });
+    x.resize(len);
+  }
+  // Convolves two ranges of integers or modints. The result holds modints if the first range does, and residues in [0, mod) otherwise.
+  template<std::ranges::sized_range R1, std::ranges::sized_range R2> auto operator()(R1&& a, R2&& b) const {
+    using Res = internal::ConvolutionResult<std::remove_cvref_t<std::ranges::range_value_t<R1>>, mod_>;
+    using Res2 = internal::ConvolutionResult<std::remove_cvref_t<std::ranges::range_value_t<R2>>, mod_>;
+    Res::check(), Res2::check();
+    Vec<u32> x(std::ranges::size(a)), y(std::ranges::size(b));
+    {
+      u32 i = 0;
+      for(auto&& v : a) x[i++] = Res::get(v);
+      i = 0;
+      for(auto&& v : b) y[i++] = Res2::get(v);
+    }
+    convolve(x, y);
+    typename Res::type res;
+    res.reserve(x.size());
+    for(u32 v : x) res.push_back(Res::make(v));
+    return res;
+  }
+};
+namespace internal {
+// NTT-friendly primes below 2^30 for the multi-prime convolutions, by decreasing 2-adicity. GarnerBits[k - 1] is a lower bound of log2 of the product of the first k primes.
+inline constexpr u32 GarnerPrimes[6] = {469762049, 167772161, 754974721, 998244353, 985661441, 943718401};
+inline constexpr u32 GarnerBits[6] = {28, 56, 85, 115, 145, 175};
+// For the Garner step of prime k against prime i < k: offset[k][i] is a multiple of GarnerPrimes[k] above every residue of prime i, and coef[k][i] is the inverse of GarnerPrimes[i] modulo GarnerPrimes[k] in Montgomery form.
+inline constexpr auto GarnerTable = [] {
+  struct {
+    u32 offset[6][6], coef[6][6];
+  } res{};
+  for(u32 k = 0; k != 6; ++k) {
+    const u64 p = GarnerPrimes[k];
+    for(u32 i = 0; i != k; ++i) {
+      u64 inv = 1, b = GarnerPrimes[i] % p;
+      for(u64 e = p - 2; e != 0; e >>= 1, b = b * b % p)
+        if(e & 1) inv = inv * b % p;
+      res.offset[k][i] = ((1u << 30) / p + 1) * p, res.coef[k][i] = (inv << 32) % p;
+    }
+  }
+  return res;
+}();
+template<u32 I, u32 K> void GarnerResidues(const Vec<u64>& a, const Vec<u64>& b, Vec<u32>* r) {
+  constexpr u32 p = GarnerPrimes[I];
+  Vec<u32> x(a.size()), y(b.size());
+  for(u32 i = 0; i != a.size(); ++i) x[i] = a[i] % p;
+  for(u32 i = 0; i != b.size(); ++i) y[i] = b[i] % p;
+  Convolution<p>::convolve(x, y);
+  r[I] = std::move(x);
+  if constexpr(I + 1 != K) GarnerResidues<I + 1, K>(a, b, r);
+}
+// Turns the residues of prime I into the I-th mixed-radix digit, so that the value is r[0] + r[1] p0 + r[2] p0 p1 + ...
+template<u32 I, u32 K> void GarnerDigits(Vec<u32>* r) {
+  if constexpr(I != K) {
+    constexpr u32 p = GarnerPrimes[I];
+    const u32 n = r[I].size();
+    for(u32 i = 0; i != I; ++i) {
+#ifdef GSH_INTERNAL_CONVOLUTION_HAS_AVX2
+      if(HasAVX2()) NttAVX2Kernel<p>::garner(r[I].data(), r[i].data(), n, GarnerTable.offset[I][i], GarnerTable.coef[I][i]);
+      else
+#endif
+        NttScalarKernel<p>::garner(r[I].data(), r[i].data(), n, GarnerTable.offset[I][i], GarnerTable.coef[I][i]);
+    }
+    GarnerDigits<I + 1, K>(r);
+  }
+}
+// Convolves a and b exactly, provided that every coefficient is below 2^bits, and passes the mixed-radix digits of the result and their count to f.
+template<u32 K = 1, class F> void GarnerConvolution(const Vec<u64>& a, const Vec<u64>& b, u32 bits, F&& f) {
+  if constexpr(K > 6) throw Exception("gsh::internal::GarnerConvolution / The coefficients are too large. ( bits=", bits, " )");
+  else if(bits > GarnerBits[K - 1]) GarnerConvolution<K + 1>(a, b, bits, f);
+  else {
+    Vec<u32> r[K];
+    GarnerResidues<0, K>(a, b, r);
+    GarnerDigits<1, K>(r);
+    f(static_cast<const Vec<u32>*>(r), K);
+  }
+}
+template<class R> Vec<u64> GarnerCollect(R&& r) {
+  Vec<u64> res;
+  res.reserve(std::ranges::size(r));
+  for(auto&& v : r) {
+    using T = std::remove_cvref_t<decltype(v)>;
+    if constexpr(requires { v.val(); }) res.push_back(v.val());
+    else if constexpr(std::is_signed_v<T>) {
+      if(v < 0) [[unlikely]]
+        throw Exception("gsh::ConvolutionExact::operator() / Negative values are not supported. ( v=", v, " )");
+      res.push_back(v);
+    } else res.push_back(v);
+  }
+  return res;
+}
+}
+// Convolution of modints under any modulus, including dynamic ones. The coefficients are computed exactly over as few NTT-friendly primes as their size allows (three for 32-bit moduli, up to six for 64-bit ones) and reduced by Garner's algorithm.
+class ConvolutionAnyMod {
+public:
+  template<std::ranges::sized_range R1, std::ranges::sized_range R2> auto operator()(R1&& a, R2&& b) const {
+    using T = std::remove_cvref_t<std::ranges::range_value_t<R1>>;
+    static_assert(std::same_as<T, std::remove_cvref_t<std::ranges::range_value_t<R2>>>, "gsh::ConvolutionAnyMod / Both ranges must hold the same modint type.");
+    Vec<T> res;
+    const Vec<u64> x = internal::GarnerCollect(a), y = internal::GarnerCollect(b);
+    if(x.empty() || y.empty()) return res;
+    const u32 bits = 2 * std::bit_width(static_cast<u64>(T::mod() - 1)) + std::bit_width(static_cast<u64>(x.size() < y.size() ? x.size() : y.size()));
+    internal::GarnerConvolution(x, y, bits, [&](const Vec<u32>* r, u32 k) {
+      T p[6];
+      for(u32 i = 0; i != k; ++i) p[i] = internal::GarnerPrimes[i];
+      const u32 len = r[0].size();
+      res.resize(len);
+      for(u32 i = 0; i != len; ++i) {
+        T v = r[k - 1][i];
+        for(u32 j = k - 1; j-- != 0;) v = v * p[j] + T(r[j][i]);
+        res[i] = v;
+      }
+    });
+    return res;
+  }
+};
+// Exact convolution of nonnegative integers below 2^64, returned modulo 2^64 or 2^128 by choosing T = u64 or u128. The number of primes is chosen from the largest inputs.
+template<class T = u64> class ConvolutionExact {
+  static_assert(std::same_as<T, u64> || std::same_as<T, u128>, "gsh::ConvolutionExact / The result type must be u64 or u128.");
+public:
+  template<std::ranges::sized_range R1, std::ranges::sized_range R2> Vec<T> operator()(R1&& a, R2&& b) const {
+    Vec<T> res;
+    const Vec<u64> x = internal::GarnerCollect(a), y = internal::GarnerCollect(b);
+    if(x.empty() || y.empty()) return res;
+    u64 mx = 0, my = 0;
+    for(u64 v : x) mx = mx < v ? v : mx;
+    for(u64 v : y) my = my < v ? v : my;
+    const u32 bits = std::bit_width(mx) + std::bit_width(my) + std::bit_width(static_cast<u64>(x.size() < y.size() ? x.size() : y.size()));
+    internal::GarnerConvolution(x, y, bits, [&](const Vec<u32>* r, u32 k) {
+      const u32 len = r[0].size();
+      res.resize(len);
+      for(u32 i = 0; i != len; ++i) {
+        T v = r[k - 1][i];
+        for(u32 j = k - 1; j-- != 0;) v = v * internal::GarnerPrimes[j] + r[j][i];
+        res[i] = v;
+      }
+    });
+    return res;
+  }
+};
+}
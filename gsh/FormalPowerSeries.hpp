@@ -0,0 +1,204 @@
+#pragma once
+#include "Convolution.hpp"
+#include "Exception.hpp"
+#include "Modint.hpp"
+#include "TypeDef.hpp"
+#include "Vec.hpp"
+#include "internal/Operation.hpp"
+#include <bit>
+#include <initializer_list>
+#include <optional>
+#include <ranges>
+namespace gsh {
+// Truncated formal power series over an NTT-friendly prime. inv, log, exp, pow and sqrt take the number of coefficients to compute and run in O(n log n) by Newton doubling, reusing the transforms of the known half of the result (middle products) instead of full-length products.
+template<u32 mod_ = 998244353> class FormalPowerSeries : public Vec<StaticModint32<mod_>>, public internal::ArithmeticInterface<FormalPowerSeries<mod_>> {
+  using mint = StaticModint32<mod_>;
+  using base = Vec<mint>;
+  using ntt = Convolution<mod_>;
+  static void transform(Vec<mint>& a) { ntt::transform(reinterpret_cast<u32*>(a.data()), a.size()); }
+  static void inverse_transform(Vec<mint>& a) {
+    ntt::inverse_transform(reinterpret_cast<u32*>(a.data()), a.size());
+    VecMul(a, mint(a.size()).inv());
+  }
+  // Multiplies the first n points of two transforms.
+  static void dot(Vec<mint>& a, const Vec<mint>& b, u32 n) { mint::vec_mul(a.data(), b.data(), n); }
+  // inv_table(n)[i] = 1 / i for 0 < i < n.
+  static Vec<mint> inv_table(u32 n) {
+    Vec<mint> res(n < 2 ? 2 : n);
+    res[1] = 1;
+    for(u32 i = 2; i < n; ++i) res[i] = -res[mod_ % i] * mint(mod_ / i);
+    return res;
+  }
+  mint coef(u32 i) const { return i < this->size() ? (*this)[i] : mint(0); }
+public:
+  using value_type = mint;
+  constexpr FormalPowerSeries() {}
+  explicit FormalPowerSeries(u32 n) : base(n) {}
+  FormalPowerSeries(u32 n, const mint& x) : base(n, x) {}
+  FormalPowerSeries(std::initializer_list<mint> il) : base(il) {}
+  FormalPowerSeries(const Vec<mint>& v) : base(v) {}
+  FormalPowerSeries(Vec<mint>&& v) : base(std::move(v)) {}
+  template<std::forward_iterator Iter, std::sentinel_for<Iter> Sent> FormalPowerSeries(Iter first, Sent last) : base(first, last) {}
+  FormalPowerSeries& operator+=(const FormalPowerSeries& g) {
+    if(this->size() < g.size()) this->resize(g.size());
+    for(u32 i = 0; i != g.size(); ++i) (*this)[i] += g[i];
+    return *this;
+  }
+  FormalPowerSeries& operator-=(const FormalPowerSeries& g) {
+    if(this->size() < g.size()) this->resize(g.size());
+    for(u32 i = 0; i != g.size(); ++i) (*this)[i] -= g[i];
+    return *this;
+  }
+  FormalPowerSeries& operator*=(const FormalPowerSeries& g) {
+    static_cast<base&>(*this) = ntt{}(static_cast<const base&>(*this), static_cast<const base&>(g));
+    return *this;
+  }
+  FormalPowerSeries& operator*=(const mint& c) {
+    VecMul(*this, c);
+    return *this;
+  }
+  FormalPowerSeries operator-() const {
+    FormalPowerSeries res = *this;
+    for(auto& x : res) x = -x;
+    return res;
+  }
+  FormalPowerSeries prefix(u32 n) const {
+    FormalPowerSeries res(n);
+    for(u32 i = 0; i != n && i != this->size(); ++i) res[i] = (*this)[i];
+    return res;
+  }
+  FormalPowerSeries derivative() const {
+    FormalPowerSeries res(this->size() < 2 ? 0 : this->size() - 1);
+    for(u32 i = 0; i != res.size(); ++i) res[i] = (*this)[i + 1] * mint(i + 1);
+    return res;
+  }
+  FormalPowerSeries integral() const {
+    const Vec<mint> iv = inv_table(this->size() + 1);
+    FormalPowerSeries res(this->size() + 1);
+    for(u32 i = 0; i != this->size(); ++i) res[i + 1] = (*this)[i] * iv[i + 1];
+    return res;
+  }
+  // 1 / f mod x^n. f[0] must be nonzero.
+  FormalPowerSeries inv(u32 n) const {
+    if(coef(0) == mint(0)) [[unlikely]]
+      throw Exception("gsh::FormalPowerSeries::inv / The constant term is zero.");
+    FormalPowerSeries res(n);
+    if(n == 0) return res;
+    res[0] = (*this)[0].inv();
+    Vec<mint> f, g;
+    for(u32 d = 1; d < n; d <<= 1) {
+      // With g = 1 / f mod x^d, f g = 1 + x^d h. Only h mod x^d is needed, so the product is taken cyclically over 2d points and its low half is discarded.
+      f.assign(2 * d, mint(0)), g.assign(2 * d, mint(0));
+      for(u32 i = 0; i != 2 * d && i != this->size(); ++i) f[i] = (*this)[i];
+      for(u32 i = 0; i != d; ++i) g[i] = res[i];
+      transform(f), transform(g);
+      dot(f, g, 2 * d);
+      inverse_transform(f);
+      for(u32 i = 0; i != d; ++i) f[i] = 0;
+      transform(f);
+      dot(f, g, 2 * d);
+      inverse_transform(f);
+      for(u32 i = d; i != 2 * d && i != n; ++i) res[i] = -f[i];
+    }
+    return res;
+  }
+  // log f mod x^n. f[0] must be 1.
+  FormalPowerSeries log(u32 n) const {
+    if(coef(0) != mint(1)) [[unlikely]]
+      throw Exception("gsh::FormalPowerSeries::log / The constant term must be 1.");
+    if(n == 0) return FormalPowerSeries();
+    FormalPowerSeries res = prefix(n).derivative();
+    res *= inv(n);
+    res.resize(n - 1);
+    return res.integral();
+  }
+  // exp f mod x^n. f[0] must be 0.
+  // The result b and its inverse c are doubled together; c is kept one step behind, and the transforms of b and c are shared between the steps.
+  FormalPowerSeries exp(u32 n) const {
+    if(coef(0) != mint(0)) [[unlikely]]
+      throw Exception("gsh::FormalPowerSeries::exp / The constant term must be 0.");
+    if(n <= 2) return FormalPowerSeries{mint(1), coef(1)}.prefix(n);
+    const Vec<mint> iv = inv_table(std::bit_ceil(n));
+    Vec<mint> b{mint(1), coef(1)}, c{mint(1)}, y, z, z1, z2{mint(1), mint(1)}, x;
+    b.reserve(n), c.reserve(n);
+    for(u32 m = 2; m < n; m <<= 1) {
+      // c <- 1 / b mod x^m.
+      y = b, y.resize(2 * m), transform(y);
+      z1 = std::move(z2);
+      z.assign(m, mint(0));
+      for(u32 i = 0; i != m; ++i) z[i] = y[i] * z1[i];
+      inverse_transform(z);
+      for(u32 i = 0; i != m / 2; ++i) z[i] = 0;
+      transform(z);
+      for(u32 i = 0; i != m; ++i) z[i] *= -z1[i];
+      inverse_transform(z);
+      c.insert(c.end(), z.begin() + m / 2, z.end());
+      z2 = c, z2.resize(2 * m), transform(z2);
+      // x <- f' - b' / b mod x^(2m - 1), computed from the error term of b' c against f'.
+      x.assign(m, mint(0));
+      for(u32 i = 0; i + 1 != m; ++i) x[i] = coef(i + 1) * mint(i + 1);
+      transform(x);
+      dot(x, y, m);
+      inverse_transform(x);
+      for(u32 i = 0; i + 1 != m; ++i) x[i] -= b[i + 1] * mint(i + 1);
+      x.resize(2 * m);
+      for(u32 i = 0; i + 1 != m; ++i) x[m + i] = x[i], x[i] = 0;
+      transform(x);
+      dot(x, z2, 2 * m);
+      inverse_transform(x);
+      // b <- b (1 + f - log b) mod x^(2m), of which only the upper half is new.
+      x.pop_back();
+      x.insert(x.begin(), mint(0));
+      for(u32 i = 1; i != 2 * m; ++i) x[i] *= iv[i];
+      for(u32 i = m; i != 2 * m; ++i) x[i] += coef(i);
+      for(u32 i = 0; i != m; ++i) x[i] = 0;
+      transform(x);
+      dot(x, y, 2 * m);
+      inverse_transform(x);
+      b.insert(b.end(), x.begin() + m, x.end());
+    }
+    return FormalPowerSeries(std::move(b)).prefix(n);
+  }
+  // f^k mod x^n, with 0^0 = 1.
+  FormalPowerSeries pow(u64 k, u32 n) const {
+    FormalPowerSeries res(n);
+    if(n == 0) return res;
+    if(k == 0) {
+      res[0] = 1;
+      return res;
+    }
+    u32 i = 0;
+    while(i != this->size() && (*this)[i] == mint(0)) ++i;
+    if(i == this->size() || (i != 0 && (k >= n || i * k >= n))) return res;
+    const u32 shift = i * k, m = n - shift;
+    const mint c = (*this)[i], ic = c.inv();
+    FormalPowerSeries g(this->begin() + i, this->begin() + (this->size() - i < m ? this->size() : i + m));
+    g *= ic;
+    g = g.log(m);
+    g *= mint(k);
+    g = g.exp(m);
+    const mint ck = c.pow(k);
+    for(u32 j = 0; j != m; ++j) res[shift + j] = g[j] * ck;
+    return res;
+  }
+  // A square root of f mod x^n, or nullopt if none exists.
+  std::optional<FormalPowerSeries> sqrt(u32 n) const {
+    FormalPowerSeries res(n);
+    u32 i = 0;
+    while(i != this->size() && (*this)[i] == mint(0)) ++i;
+    if(i == this->size() || i / 2 >= n) return res;
+    if(i % 2 == 1) return std::nullopt;
+    const mint c = (*this)[i];
+    if(c.legendre() != 1) return std::nullopt;
+    const mint s = c.sqrt();
+    const u32 shift = i / 2, m = n - shift;
+    FormalPowerSeries g(this->begin() + i, this->begin() + (this->size() - i < m ? this->size() : i + m));
+    g *= c.inv();
+    g = g.log(m);
+    g *= mint(2).inv();
+    g = g.exp(m);
+    for(u32 j = 0; j != m; ++j) res[shift + j] = g[j] * s;
+    return res;
+  }
+};
+}
@@ -4,9 +4,11 @@
 #include "TypeDef.hpp"
 #include "Util.hpp"
 #include "internal/UtilMacro.hpp"
+#include <bit>
 #include <charconv>
 #include <concepts>
 #include <cstddef>
+#include <limits>
 #include <ranges>
 #include <system_error>
 #include <tuple>
@@ -34,6 +36,8 @@ constexpr FormatterOption operator|(FormatterOption a, FormatterOption b) noexce
 [[maybe_unused]] constexpr auto General = static_cast<FormatterOption>(std::chars_format::general);
 [[maybe_unused]] constexpr auto Hex = static_cast<FormatterOption>(std::chars_format::hex);
 [[maybe_unused]] constexpr auto Scientific = static_cast<FormatterOption>(std::chars_format::scientific);
+// Combined with a format (e.g. Fixed | Shortest), prints the shortest representation that round-trips and ignores the precision. On its own it lets std::to_chars pick the shorter of fixed and scientific.
+[[maybe_unused]] constexpr auto Shortest = static_cast<FormatterOption>(0x100);
 }
 template<class T> class Formatter;
 namespace internal {
@@ -172,6 +176,14 @@ template<bool Flag = false, class Stream> constexpr void Formatu16dig(Stream&& s
   }
   stream.skip(p - cur);
 }
+// Writes through a raw pointer without bounds checks. Used after enough room has been reserved for a whole block.
+struct RawWriter {
+  c8* cur;
+  constexpr void reload() const noexcept {}
+  constexpr void reload(u32) const noexcept {}
+  constexpr c8* current() const noexcept { return cur; }
+  constexpr void skip(u32 n) noexcept { cur += n; }
+};
 template<class T, u32 Reload, auto Func> struct UnsignedFormatter {
   using value_type = T;
   template<class Stream> constexpr void operator()(Stream&& stream, T n) const {
@@ -188,14 +200,71 @@ template<class T, u32 Reload, auto Func> struct SignedFormatter {
     Func(stream, n < 0 ? -n : n);
   }
 };
+// Exact fixed-precision formatting of a binary64 value m * 2^e. The value is scaled by 10^precision in 128-bit arithmetic and rounded half to even, which gives the same digits as std::to_chars. Returns false when the scaled value does not fit in 64 bits, or for inf and nan.
+template<class Stream> constexpr bool FormatFixedf64(Stream&& stream, f64 f, u32 precision) {
+  const u64 bits = std::bit_cast<u64>(f);
+  const u32 be = bits >> 52 & 0x7ff;
+  if(be == 0x7ff) return false;
+  u64 m = bits & ((u64(1) << 52) - 1);
+  i32 e = -1074;
+  if(be != 0) m |= u64(1) << 52, e = static_cast<i32>(be) - 1075;
+  const u64 pw = Pow10Table[precision];
+  u64 ip, fp;
+  if(e >= 0) {
+    if(e >= std::countl_zero(m)) return false;
+    ip = m << e, fp = 0;
+  } else {
+    const u32 sh = -e;
+    u64 q = 0;
+    if(sh < 111) {
+      const u128 prod = static_cast<u128>(m) * pw;
+      const u128 q128 = prod >> sh;
+      if((q128 >> 64) != 0 || static_cast<u64>(q128) == ~u64(0)) return false;
+      const u128 r = prod - (q128 << sh), half = static_cast<u128>(1) << (sh - 1);
+      q = static_cast<u64>(q128);
+      q += r > half || (r == half && (q & 1));
+    }
+    ip = q / pw, fp = q % pw;
+  }
+  *stream.current() = '-';
+  stream.skip(bits >> 63);
+  Formatu64(stream, ip);
+  if(precision != 0) {
+    c8* p = stream.current();
+    *p = '.';
+    const u32 pad = (4 - precision % 4) % 4, g = (precision + pad) / 4;
+    u64 x = fp * Pow10Table[pad];
+    for(c8* d = p + 1 + 4 * g; d != p + 1; x /= 10000) {
+      d -= 4;
+      MemoryCopy(d, InttoStr<false>.table + 4 * (x % 10000), 4);
+    }
+    stream.skip(precision + 1);
+  }
+  return true;
+}
 template<class T> struct FloatFormatter {
   using value_type = T;
   template<class Stream> constexpr void operator()(Stream&& stream, T f, io::FormatterOption fmt = io::Fixed, i32 precision = 12) {
+    if constexpr(sizeof(T) <= sizeof(f64)) {
+      if(fmt == io::Fixed && 0 <= precision && precision <= 16) {
+        stream.reload(48);
+        if(FormatFixedf64(stream, static_cast<f64>(f), precision)) [[likely]]
+          return;
+      }
+    }
     stream.reload(32);
-    auto [ptr, err] = std::to_chars(stream.current(), stream.current() + stream.avail(), f, static_cast<std::chars_format>(fmt), precision);
+    using U = std::underlying_type_t<io::FormatterOption>;
+    const bool shortest = static_cast<U>(fmt) & static_cast<U>(io::Shortest);
+    const auto cf = static_cast<std::chars_format>(static_cast<U>(fmt) & ~static_cast<U>(io::Shortest));
+    auto conv = [&]() {
+      if(!shortest) return std::to_chars(stream.current(), stream.current() + stream.avail(), f, cf, precision);
+      if(cf == std::chars_format{}) return std::to_chars(stream.current(), stream.current() + stream.avail(), f);
+      return std::to_chars(stream.current(), stream.current() + stream.avail(), f, cf);
+    };
+    auto [ptr, err] = conv();
     if(err != std::errc{}) [[unlikely]] {
       stream.reload();
-      auto [ptr, err] = std::to_chars(stream.current(), stream.current() + stream.avail(), f, static_cast<std::chars_format>(fmt), precision);
+      auto [ptr, err] = conv();
       if(err != std::errc{}) throw Exception("gsh::internal::FloatFormatter::operator() / The value is too large.");
       stream.skip(ptr - stream.current());
     } else {
@@ -306,6 +375,27 @@ template<FormatableRange R> class Formatter<R> {
     auto first = std::ranges::begin(r);
     auto last = std::ranges::end(r);
     if(!(first != last)) return;
+    using value_type = std::decay_t<std::ranges::range_value_t<R>>;
+    if constexpr(std::ranges::sized_range<R> && std::integral<value_type> && std::same_as<std::decay_t<U>, c8>) {
+      // Integers separated by a character are written in blocks, with one reload check per block instead of two per value.
+      constexpr u32 block = 64, width = std::numeric_limits<value_type>::digits10 + 3;
+      Formatter<value_type> formatter;
+      u32 rem = std::ranges::size(r);
+      while(rem != 0) {
+        const u32 k = rem < block ? rem : block;
+        stream.reload(k * width);
+        if(stream.avail() < k * width) [[unlikely]]
+          break;
+        internal::RawWriter w{stream.current()};
+        for(u32 i = 0; i != k; ++i, ++first) {
+          formatter(w, *first);
+          *(w.cur++) = sep;
+        }
+        rem -= k;
+        stream.skip(w.cur - stream.current() - (rem == 0));
+      }
+      if(rem == 0) return;
+    }
     Formatter<std::decay_t<std::ranges::range_value_t<R>>> formatter;
     while(true) {
       formatter(stream, *first);
@@ -1,18 +1,25 @@
 #pragma once
+#include "Algorithm.hpp" // IWYU pragma: keep
 #include "Exception.hpp"
 #include "Functional.hpp"
 #include "Heap.hpp"
 #include "Memory.hpp"
+#include "Parser.hpp"
 #include "Range.hpp"
 #include "TypeDef.hpp"
 #include "UnionFind.hpp"
 #include "Vec.hpp"
 #include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cstddef>
 #include <functional>
 #include <iterator>
 #include <limits>
+#include <optional>
 #include <ranges>
+#include <span>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -62,17 +69,23 @@ namespace gsh {
 namespace internal {
 template<class W, bool IsConst> class AdjacencyList : public ViewInterface<AdjacencyList<W, IsConst>, Edge<W>> {
   constexpr static u32 npos = 0xffffffffu;
-  using storage_type = Vec<std::pair<Edge<W>, u32>>;
-  using storage_ptr_type = std::conditional_t<IsConst, typename storage_type::const_iterator, typename storage_type::iterator>;
-  storage_ptr_type storage_ptr;
-  u32 idx;
+  using edge_ptr_type = std::conditional_t<IsConst, const Edge<W>*, Edge<W>*>;
+  edge_ptr_type edge_ptr;
+  const u32* link;
+  u32 first, last;
   template<class W2> friend class CRS;
-  constexpr AdjacencyList(storage_ptr_type p, u32 i) : storage_ptr(p), idx(i) {}
-  class sentinel_impl {};
+  constexpr AdjacencyList(edge_ptr_type p, const u32* l, u32 f, u32 e) : edge_ptr(p), link(l), first(f), last(e) {}
+  class sentinel_impl {
+  public:
+    u32 last = npos;
+    constexpr sentinel_impl() {}
+    constexpr sentinel_impl(u32 e) : last(e) {}
+  };
   template<bool IterIsConst> class iterator_impl {
-    storage_ptr_type storage_ptr;
+    edge_ptr_type edge_ptr;
+    const u32* link;
     u32 current_idx;
-    constexpr iterator_impl(storage_ptr_type p, u32 i) : storage_ptr(p), current_idx(i) {}
+    constexpr iterator_impl(edge_ptr_type p, const u32* l, u32 i) : edge_ptr(p), link(l), current_idx(i) {}
     friend class AdjacencyList;
   public:
     using difference_type = i32;
@@ -80,11 +93,11 @@ template<class W, bool IsConst> class AdjacencyList : public ViewInterface<Adjac
     using pointer = std::conditional_t<IterIsConst, const value_type*, value_type*>;
     using reference = std::conditional_t<IterIsConst, const value_type&, value_type&>;
     using iterator_category = std::forward_iterator_tag;
-    constexpr iterator_impl() : storage_ptr(nullptr), current_idx(-1) {}
-    constexpr reference operator*() const noexcept { return storage_ptr[current_idx].first; }
-    constexpr pointer operator->() const noexcept { return &(storage_ptr[current_idx].first); }
+    constexpr iterator_impl() : edge_ptr(nullptr), link(nullptr), current_idx(npos) {}
+    constexpr reference operator*() const noexcept { return edge_ptr[current_idx]; }
+    constexpr pointer operator->() const noexcept { return edge_ptr + current_idx; }
     constexpr iterator_impl& operator++() {
-      current_idx = storage_ptr[current_idx].second;
+      current_idx = link == nullptr ? current_idx + 1 : link[current_idx];
       return *this;
     }
     constexpr iterator_impl operator++(int) {
@@ -92,7 +105,8 @@ template<class W, bool IsConst> class AdjacencyList : public ViewInterface<Adjac
       operator++();
       return copy;
     }
-    friend constexpr bool operator==(const iterator_impl& a, const sentinel_impl&) noexcept { return a.current_idx == npos; }
+    friend constexpr bool operator==(const iterator_impl& a, const iterator_impl& b) noexcept { return a.current_idx == b.current_idx; }
+    friend constexpr bool operator==(const iterator_impl& a, const sentinel_impl& b) noexcept { return a.current_idx == b.last; }
   };
 public:
   using iterator = iterator_impl<IsConst>;
@@ -100,54 +114,129 @@ public:
   using const_iterator = iterator_impl<true>;
   using const_sentinel = sentinel_impl;
   constexpr u32 size() const noexcept {
-    u32 current_idx = idx;
+    if(link == nullptr) return last - first;
+    u32 current_idx = first;
     u32 cnt = 0;
     while(current_idx != npos) {
-      current_idx = storage_ptr[current_idx].second;
+      current_idx = link[current_idx];
       ++cnt;
     }
     return cnt;
   }
-  constexpr bool empty() const noexcept { return idx == npos; }
-  constexpr iterator begin() noexcept { return iterator(storage_ptr, idx); }
-  constexpr sentinel end() noexcept { return {}; };
-  constexpr const_iterator begin() const noexcept { return const_iterator(storage_ptr, idx); }
-  constexpr const_sentinel end() const noexcept { return {}; }
+  constexpr bool empty() const noexcept { return first == last; }
+  // Only available after CRS::freeze(). The edges are stored contiguously in [data(), data() + size()).
+  constexpr edge_ptr_type data() const noexcept { return link == nullptr ? edge_ptr + first : nullptr; }
+  constexpr iterator begin() noexcept { return iterator(edge_ptr, link, first); }
+  constexpr sentinel end() noexcept { return sentinel(last); };
+  constexpr const_iterator begin() const noexcept { return const_iterator(edge_ptr, link, first); }
+  constexpr const_sentinel end() const noexcept { return const_sentinel(last); }
 };
 template<class W> class CRS {
   constexpr static u32 npos = 0xffffffffu;
-  Vec<std::pair<Edge<W>, u32>> storage;
-  Vec<u32> tail;
+  Vec<Edge<W>> edges;
+  Vec<u32> link, tail, offset;
   constexpr static bool is_weighted = Edge<W>::is_weighted;
   template<bool IsConst> using adjacency_list = AdjacencyList<W, IsConst>;
+  constexpr void thaw() {
+    const u32 n = offset.size() - 1;
+    link.resize(edges.size());
+    tail.assign(n, npos);
+    for(u32 v = 0; v != n; ++v) {
+      for(u32 i = offset[v]; i != offset[v + 1]; ++i) link[i] = (i == offset[v] ? npos : i - 1);
+      if(offset[v] != offset[v + 1]) tail[v] = offset[v + 1] - 1;
+    }
+    offset.reset();
+  }
+protected:
+  // Builds the frozen form directly from M edge lines "from to [weight]" read from the stream, using two counting passes instead of per-edge connect().
+  template<bool Undirected, class Stream> constexpr void assign_edge_list(Stream&& stream, u32 n, u32 m, u32 index_base) {
+    const u32 cnt = Undirected ? 2 * m : m;
+    Vec<u32> src(cnt), off(n + 1, 0);
+    Vec<Edge<W>> es(cnt, Edge<W>(0));
+    for(u32 i = 0; i != m; ++i) {
+      const u32 a = Parser<u32>()(stream) - index_base, b = Parser<u32>()(stream) - index_base;
+#ifndef NDEBUG
+      if(a >= n || b >= n) [[unlikely]]
+        throw Exception("gsh::internal::CRS::assign_edge_list / The vertex index is out of range. ( a=", a, ", b=", b, ", n=", n, " )");
+#endif
+      if constexpr(is_weighted) es[i] = Edge<W>(b, Parser<W>()(stream));
+      else es[i] = Edge<W>(b);
+      src[i] = a;
+      ++off[a + 1];
+      if constexpr(Undirected) {
+        es[m + i] = Edge<W>(a);
+        if constexpr(is_weighted) es[m + i].weight() = es[i].weight();
+        src[m + i] = b;
+        ++off[b + 1];
+      }
+    }
+    for(u32 v = 0; v != n; ++v) off[v + 1] += off[v];
+    Vec<u32> pos(off.begin(), off.end() - 1);
+    Vec<Edge<W>> res(cnt, Edge<W>(0));
+    for(u32 i = 0; i != cnt; ++i) res[pos[src[i]]++] = std::move(es[i]);
+    edges = std::move(res);
+    link.reset();
+    tail.reset();
+    offset = std::move(off);
+  }
 public:
   constexpr CRS() {}
   constexpr explicit CRS(u32 n) : tail(n, npos) {}
-  constexpr u32 vertex_count() const noexcept { return tail.size(); }
-  constexpr u32 edge_count() const noexcept { return storage.size(); }
+  constexpr u32 vertex_count() const noexcept { return is_frozen() ? offset.size() - 1 : tail.size(); }
+  constexpr u32 edge_count() const noexcept { return edges.size(); }
+  constexpr bool is_frozen() const noexcept { return !offset.empty(); }
+  // Rearranges the edges into contiguous per-vertex blocks (in insertion order). connect() is still allowed afterwards, but it converts the storage back first.
+  constexpr void freeze() {
+    if(is_frozen()) return;
+    const u32 n = tail.size(), m = edges.size();
+    Vec<u32> off(n + 1);
+    Vec<Edge<W>> res;
+    res.reserve(m);
+    off[0] = 0;
+    for(u32 v = 0; v != n; ++v) {
+      for(u32 i = tail[v]; i != npos; i = link[i]) res.push_back(std::move(edges[i]));
+      off[v + 1] = res.size();
+      std::ranges::reverse(res.begin() + off[v], res.end());
+    }
+    edges = std::move(res);
+    link.reset();
+    tail.reset();
+    offset = std::move(off);
+  }
   constexpr void connect(u32 from, u32 to) {
-    storage.emplace_back(std::piecewise_construct, std::tuple{to}, std::tuple{tail[from]});
-    tail[from] = storage.size() - 1;
+    if(is_frozen()) [[unlikely]]
+      thaw();
+    edges.emplace_back(to);
+    link.push_back(tail[from]);
+    tail[from] = edges.size() - 1;
   }
   constexpr void connect(u32 from, u32 to, const W& w) {
-    storage.emplace_back(std::piecewise_construct, std::tuple{to, w}, std::tuple{tail[from]});
-    tail[from] = storage.size() - 1;
+    if(is_frozen()) [[unlikely]]
+      thaw();
+    edges.emplace_back(to, w);
+    link.push_back(tail[from]);
+    tail[from] = edges.size() - 1;
   }
   constexpr auto operator[](u32 v) {
 #ifndef NDEBUG
     if(v >= vertex_count()) [[unlikely]]
       throw Exception("gsh::graph_format::CRS::operator[] / The index is out of range. ( v=", v, ", size=", vertex_count(), " )");
 #endif
-    return adjacency_list<false>(storage.begin(), tail[v]);
+    if(is_frozen()) return adjacency_list<false>(edges.data(), nullptr, offset[v], offset[v + 1]);
+    return adjacency_list<false>(edges.data(), link.data(), tail[v], npos);
   }
   constexpr auto operator[](u32 v) const {
 #ifndef NDEBUG
     if(v >= vertex_count()) [[unlikely]]
       throw Exception("gsh::graph_format::CRS::operator[] const / The index is out of range. ( v=", v, ", size=", vertex_count(), " )");
 #endif
-    return adjacency_list<true>(storage.begin(), tail[v]);
+    if(is_frozen()) return adjacency_list<true>(edges.data(), nullptr, offset[v], offset[v + 1]);
+    return adjacency_list<true>(edges.data(), link.data(), tail[v], npos);
+  }
+  constexpr void reserve(u32 m) {
+    edges.reserve(m);
+    if(!is_frozen()) link.reserve(m);
   }
-  constexpr void reserve(u32 m) { storage.reserve(m); }
 };
 template<class WTT> class ShortestPathResult {
   template<class D, class W> friend class GraphInterface;
@@ -192,6 +281,243 @@ public:
     return res;
   }
 };
+template<class D, class W> class GraphInterface;
+// Priority queues used by GraphInterface::shortest_path_dijkstra. push(d, v) announces that the tentative distance of v dropped to d; queues that keep stale entries rely on the caller skipping them.
+template<class W> class DijkstraLazyHeapQueue {
+  struct Comp {
+    constexpr bool operator()(const std::pair<W, u32>& a, const std::pair<W, u32>& b) const noexcept { return a.first > b.first; }
+  };
+  Heap<std::pair<W, u32>, Comp> pq;
+public:
+  constexpr DijkstraLazyHeapQueue(u32, u32 m) { pq.reserve(m); }
+  constexpr bool empty() const noexcept { return pq.empty(); }
+  constexpr void clear() noexcept { pq.clear(); }
+  constexpr void push(const W& d, u32 v) { pq.emplace(d, v); }
+  constexpr std::pair<W, u32> pop() {
+    auto res = pq.top();
+    pq.pop();
+    return res;
+  }
+};
+// 4-ary heap of (key, vertex) with a position table, so that each vertex occupies at most one slot.
+template<class W> class DijkstraIndexedHeapQueue {
+  constexpr static u32 npos = 0xffffffffu;
+  Vec<std::pair<W, u32>> heap;
+  Vec<u32> pos;
+  constexpr void push_up(u32 i, std::pair<W, u32> x) {
+    while(i != 0) {
+      const u32 p = (i - 1) / 4;
+      if(!(x.first < heap[p].first)) break;
+      heap[i] = heap[p];
+      pos[heap[i].second] = i;
+      i = p;
+    }
+    heap[i] = x;
+    pos[x.second] = i;
+  }
+  constexpr void push_down(u32 i, std::pair<W, u32> x) {
+    const u32 n = heap.size();
+    while(true) {
+      const u32 ch = 4 * i + 1;
+      if(ch >= n) break;
+      const u32 last = ch + 4 < n ? ch + 4 : n;
+      u32 m = ch;
+      for(u32 j = ch + 1; j < last; ++j) m = heap[j].first < heap[m].first ? j : m;
+      if(!(heap[m].first < x.first)) break;
+      heap[i] = heap[m];
+      pos[heap[i].second] = i;
+      i = m;
+    }
+    heap[i] = x;
+    pos[x.second] = i;
+  }
+public:
+  constexpr DijkstraIndexedHeapQueue(u32 n, u32) : pos(n, npos) { heap.reserve(n); }
+  constexpr bool empty() const noexcept { return heap.empty(); }
+  constexpr void clear() noexcept {
+    for(const auto& x : heap) pos[x.second] = npos;
+    heap.clear();
+  }
+  constexpr void push(const W& d, u32 v) {
+    if(pos[v] == npos) {
+      heap.emplace_back(d, v);
+      push_up(heap.size() - 1, {d, v});
+    } else push_up(pos[v], {d, v});
+  }
+  constexpr std::pair<W, u32> pop() {
+    const auto res = heap[0];
+    pos[res.second] = npos;
+    const auto last = heap.back();
+    heap.pop_back();
+    if(!heap.empty()) push_down(0, last);
+    return res;
+  }
+};
+// Monotone radix heap. An entry with key x lives in bucket bit_width(x ^ last), where last is the most recently popped key, so every entry moves down at most bit-width-of-W times.
+template<class W> class DijkstraRadixHeapQueue {
+  static_assert(std::is_integral_v<W>, "gsh::internal::DijkstraRadixHeapQueue / W must be integral.");
+  using key_type = std::make_unsigned_t<W>;
+  constexpr static u32 bucket_count = std::numeric_limits<key_type>::digits + 1;
+  Vec<std::pair<key_type, u32>> bucket[bucket_count];
+  key_type last = 0;
+  u32 sz = 0;
+  constexpr static u32 index(key_type x, key_type l) noexcept { return std::bit_width(static_cast<key_type>(x ^ l)); }
+public:
+  constexpr DijkstraRadixHeapQueue(u32, u32) {}
+  constexpr bool empty() const noexcept { return sz == 0; }
+  constexpr void clear() noexcept {
+    for(auto& b : bucket) b.clear();
+    last = 0, sz = 0;
+  }
+  constexpr void push(const W& d, u32 v) {
+    const key_type x = static_cast<key_type>(d);
+    bucket[index(x, last)].emplace_back(x, v);
+    ++sz;
+  }
+  constexpr std::pair<W, u32> pop() {
+    if(bucket[0].empty()) {
+      u32 i = 1;
+      while(bucket[i].empty()) ++i;
+      key_type mn = bucket[i][0].first;
+      for(const auto& [x, v] : bucket[i]) mn = x < mn ? x : mn;
+      last = mn;
+      for(const auto& [x, v] : bucket[i]) bucket[index(x, last)].emplace_back(x, v);
+      bucket[i].clear();
+    }
+    const u32 v = bucket[0].back().second;
+    bucket[0].pop_back();
+    --sz;
+    return {static_cast<W>(last), v};
+  }
+};
+// Dial's bucket queue: a ring of doubly linked vertex lists indexed by the key modulo a power of two. The ring grows when a key exceeds the current minimum by more than its length, so its final length is about the maximum edge weight.
+template<class W> class DijkstraBucketQueueQueue {
+  static_assert(std::is_integral_v<W>, "gsh::internal::DijkstraBucketQueueQueue / W must be integral.");
+  constexpr static u32 npos = 0xffffffffu;
+  Vec<u32> head, next, prev;
+  Vec<W> key;
+  Vec<u8> queued;
+  Vec<u32> touched; // every vertex queued since the last clear, so that clear costs no more than the pushes did
+  W cur{};
+  u32 mask = 0, sz = 0;
+  constexpr void link(u32 v) {
+    const u32 b = static_cast<u32>(key[v]) & mask;
+    prev[v] = npos;
+    next[v] = head[b];
+    if(head[b] != npos) prev[head[b]] = v;
+    head[b] = v;
+  }
+  constexpr void unlink(u32 v) {
+    if(prev[v] != npos) next[prev[v]] = next[v];
+    else head[static_cast<u32>(key[v]) & mask] = next[v];
+    if(next[v] != npos) prev[next[v]] = prev[v];
+  }
+  constexpr void grow(u64 span) {
+    if(span >= 0x80000000u) [[unlikely]]
+      throw Exception("gsh::internal::DijkstraBucketQueueQueue::grow / The edge weight is too large. ( span=", span, " )");
+    Vec<u32> old = std::move(head);
+    const u32 len = std::bit_ceil(static_cast<u32>(span + 1));
+    head.assign(len, npos);
+    mask = len - 1;
+    for(u32 b : old) {
+      while(b != npos) {
+        const u32 nx = next[b];
+        link(b);
+        b = nx;
+      }
+    }
+  }
+public:
+  constexpr DijkstraBucketQueueQueue(u32 n, u32) : head(1, npos), next(n), prev(n), key(n), queued(n, 0) {}
+  constexpr bool empty() const noexcept { return sz == 0; }
+  constexpr void clear() noexcept {
+    for(u32 v : touched) {
+      if(!queued[v]) continue;
+      head[static_cast<u32>(key[v]) & mask] = npos;
+      queued[v] = 0;
+    }
+    touched.clear();
+    cur = W{}, sz = 0;
+  }
+  constexpr void push(const W& d, u32 v) {
+    if(queued[v]) unlink(v);
+    else queued[v] = 1, ++sz, touched.push_back(v);
+    key[v] = d;
+    if(static_cast<u64>(d - cur) > mask) grow(static_cast<u64>(d - cur));
+    link(v);
+  }
+  constexpr std::pair<W, u32> pop() {
+    while(head[static_cast<u32>(cur) & mask] == npos) ++cur;
+    const u32 v = head[static_cast<u32>(cur) & mask];
+    unlink(v);
+    queued[v] = 0;
+    --sz;
+    return {cur, v};
+  }
+};
+}
+// Queue policies for GraphInterface::shortest_path_dijkstra.
+// DijkstraLazyHeap (default): gsh::Heap with lazy deletion, up to m entries.
+// DijkstraIndexedHeap: decrease-key heap holding at most one entry per vertex, O(n) memory.
+// DijkstraRadixHeap: monotone radix heap, O(m + n log C) for integral weights.
+// DijkstraBucketQueue: Dial's buckets, O(m + n + D) where D is the distance to the farthest vertex; best when the maximum edge weight is small.
+struct DijkstraLazyHeap {
+  template<class W> using queue_type = internal::DijkstraLazyHeapQueue<W>;
+};
+struct DijkstraIndexedHeap {
+  template<class W> using queue_type = internal::DijkstraIndexedHeapQueue<W>;
+};
+struct DijkstraRadixHeap {
+  template<class W> using queue_type = internal::DijkstraRadixHeapQueue<W>;
+};
+struct DijkstraBucketQueue {
+  template<class W> using queue_type = internal::DijkstraBucketQueueQueue<W>;
+};
+// Scratch space for repeated shortest path queries on graphs with the same vertex count. Entries are stamped with the query epoch, so starting a query costs O(1) instead of O(n); the arrays and the queue are only reallocated when the vertex count changes.
+template<class W2, class Queue = DijkstraLazyHeap> class ShortestPathWorkspace {
+  template<class D, class W> friend class internal::GraphInterface;
+  constexpr static u32 npos = 0xffffffff;
+  using queue_type = typename Queue::template queue_type<W2>;
+  Vec<W2> dist_;
+  Vec<u32> prev_, stamp_, mark_, fifo_;
+  std::optional<queue_type> pq_;
+  u32 epoch_ = 0;
+  constexpr void start(u32 n, u32 m) {
+    if(n != stamp_.size()) {
+      dist_.resize(n), prev_.resize(n), fifo_.resize(n);
+      stamp_.assign(n, 0), mark_.assign(n, 0);
+      pq_.reset();
+      epoch_ = 0;
+    }
+    if(!pq_) pq_.emplace(n, m);
+    else pq_->clear();
+    if(++epoch_ == 0) [[unlikely]] {
+      stamp_.assign(n, 0), mark_.assign(n, 0);
+      epoch_ = 1;
+    }
+  }
+  constexpr bool visited(u32 v) const noexcept { return stamp_[v] == epoch_; }
+  constexpr void visit(u32 v, const W2& d, u32 p) {
+    stamp_[v] = epoch_;
+    dist_[v] = d;
+    prev_[v] = p;
+  }
+public:
+  constexpr static W2 inf = std::numeric_limits<W2>::max();
+  constexpr ShortestPathWorkspace() = default;
+  constexpr u32 vertex_count() const noexcept { return stamp_.size(); }
+  constexpr W2 dist(u32 t) const { return visited(t) ? dist_[t] : inf; }
+  constexpr u32 prev(u32 t) const { return visited(t) ? prev_[t] : npos; }
+  constexpr bool is_reachable(u32 t) const { return visited(t); }
+  constexpr Vec<u32> path(u32 t) const {
+    Vec<u32> path;
+    if(!visited(t)) return path;
+    for(u32 cur = t; cur != npos; cur = prev_[cur]) path.push_back(cur);
+    path.reverse();
+    return path;
+  }
+};
+namespace internal {
 template<class D, class W> class GraphInterface {
   constexpr D& derived() noexcept { return *static_cast<D*>(this); }
   constexpr const D& derived() const noexcept { return *static_cast<const D*>(this); }
@@ -200,6 +526,33 @@ public:
   using weight_type = typename edge_type::weight_type;
   constexpr static bool is_weighted = edge_type::is_weighted;
   template<class W2> constexpr static W2 default_inf() { return std::numeric_limits<W2>::max(); }
+private:
+  template<class W2, class Queue> constexpr void dijkstra_start(ShortestPathWorkspace<W2, Queue>& ws, std::span<const u32> sources) const {
+    ws.start(derived().vertex_count(), derived().edge_count());
+    for(u32 s : sources) {
+      if(ws.visited(s)) continue;
+      ws.visit(s, W2{}, ws.npos);
+      ws.pq_->push(W2{}, s);
+    }
+  }
+  // Settles vertices until the queue runs dry or stop(v) returns true for a settled vertex v.
+  template<class W2, class Queue, class Stop> constexpr void dijkstra_run(ShortestPathWorkspace<W2, Queue>& ws, Stop&& stop) const {
+    auto& pq = *ws.pq_;
+    while(!pq.empty()) {
+      const auto [d, v] = pq.pop();
+      if(d != ws.dist_[v]) continue;
+      if(stop(v)) break;
+      for(const auto& e : derived()[v]) {
+        const u32 to = e.to();
+        const W2 nd = d + static_cast<W2>(e.weight());
+        if(!ws.visited(to) || nd < ws.dist_[to]) {
+          ws.visit(to, nd, v);
+          pq.push(nd, to);
+        }
+      }
+    }
+  }
+public:
   constexpr auto shortest_path_bfs(u32 s, u32 t = 0xffffffff) const {
     const u32 n = derived().vertex_count();
     constexpr u32 inf = std::numeric_limits<u32>::max();
@@ -254,17 +607,15 @@ public:
     }
     return res;
   }
-  template<class W2 = weight_type> constexpr auto shortest_path_dijkstra(u32 s, u32 t = 0xffffffff) const {
+  template<class W2 = weight_type, class Queue = DijkstraLazyHeap> constexpr auto shortest_path_dijkstra(u32 s, u32 t = 0xffffffff) const {
     const u32 n = derived().vertex_count();
     const auto inf = std::numeric_limits<W2>::max();
     ShortestPathResult<W2> res(inf, n);
-    Heap<std::pair<W2, u32>, decltype([](const auto& a, const auto& b) { return a.first < b.first; })> pq;
-    pq.reserve(derived().edge_count());
+    typename Queue::template queue_type<W2> pq(n, derived().edge_count());
     res.dist_[s] = W2{};
-    pq.emplace(W2{}, s);
+    pq.push(W2{}, s);
     while(!pq.empty()) {
-      auto [d, v] = pq.min();
-      pq.pop_min();
+      const auto [d, v] = pq.pop();
       if(v == t) break;
       if(d != res.dist_[v]) continue;
       for(const auto& e : derived()[v]) {
@@ -274,8 +625,138 @@ public:
         if(nd < res.dist_[to]) {
           res.dist_[to] = nd;
           res.prev_[to] = v;
-          pq.emplace(nd, to);
+          pq.push(nd, to);
+        }
+      }
+    }
+    return res;
+  }
+  // Runs a BFS from every vertex of sources at once, reusing the buffers of ws.
+  template<class W2, class Queue> constexpr void shortest_path_bfs(ShortestPathWorkspace<W2, Queue>& ws, std::span<const u32> sources, u32 t = 0xffffffff) const {
+    ws.start(derived().vertex_count(), 0);
+    u32 head = 0, tail = 0;
+    for(u32 s : sources) {
+      if(ws.visited(s)) continue;
+      ws.visit(s, W2{}, ws.npos);
+      ws.fifo_[tail++] = s;
+    }
+    while(head != tail) {
+      const u32 v = ws.fifo_[head++];
+      if(v == t) break;
+      const W2 nd = ws.dist_[v] + W2(1);
+      for(const auto& e : derived()[v]) {
+        const u32 to = e.to();
+        if(ws.visited(to)) continue;
+        ws.visit(to, nd, v);
+        ws.fifo_[tail++] = to;
+      }
+    }
+  }
+  template<class W2, class Queue> constexpr void shortest_path_bfs(ShortestPathWorkspace<W2, Queue>& ws, u32 s, u32 t = 0xffffffff) const { shortest_path_bfs(ws, std::span<const u32>(&s, 1), t); }
+  // Runs Dijkstra's algorithm from every vertex of sources at once, reusing the buffers and the queue of ws.
+  template<class W2, class Queue> constexpr void shortest_path_dijkstra(ShortestPathWorkspace<W2, Queue>& ws, std::span<const u32> sources, u32 t = 0xffffffff) const {
+    dijkstra_start(ws, sources);
+    dijkstra_run(ws, [t](u32 v) { return v == t; });
+  }
+  template<class W2, class Queue> constexpr void shortest_path_dijkstra(ShortestPathWorkspace<W2, Queue>& ws, u32 s, u32 t = 0xffffffff) const { shortest_path_dijkstra(ws, std::span<const u32>(&s, 1), t); }
+  // Returns the distance of every (s, t) pair, or ws.inf if t is unreachable. Queries are grouped by source, and each search stops as soon as all targets of its source are settled.
+  template<class W2, class Queue> constexpr Vec<W2> shortest_path_dijkstra_batch(ShortestPathWorkspace<W2, Queue>& ws, std::span<const std::pair<u32, u32>> queries) const {
+    const u32 q = queries.size();
+    Vec<W2> res(q);
+    Vec<u32> ord(q);
+    for(u32 i = 0; i != q; ++i) ord[i] = i;
+    std::ranges::sort(ord, {}, [&](u32 i) { return queries[i].first; });
+    for(u32 l = 0, r = 0; l != q; l = r) {
+      const u32 s = queries[ord[l]].first;
+      while(r != q && queries[ord[r]].first == s) ++r;
+      dijkstra_start(ws, std::span<const u32>(&s, 1));
+      u32 rem = 0;
+      for(u32 i = l; i != r; ++i) {
+        const u32 tg = queries[ord[i]].second;
+        if(ws.mark_[tg] != ws.epoch_) ws.mark_[tg] = ws.epoch_, ++rem;
+      }
+      dijkstra_run(ws, [&](u32 v) { return ws.mark_[v] == ws.epoch_ && --rem == 0; });
+      for(u32 i = l; i != r; ++i) res[ord[i]] = ws.dist(queries[ord[i]].second);
+    }
+    return res;
+  }
+  template<class W2 = weight_type, class Queue = DijkstraLazyHeap> constexpr Vec<W2> shortest_path_dijkstra_batch(std::span<const std::pair<u32, u32>> queries) const {
+    ShortestPathWorkspace<W2, Queue> ws;
+    return shortest_path_dijkstra_batch(ws, queries);
+  }
+  // A* search from s to t. h(v) must be an admissible lower bound on the distance from v to t; vertices are reopened when a shorter path to them appears, so h need not be consistent unless Queue is monotone (DijkstraRadixHeap, DijkstraBucketQueue). Only dist(t) and path(t) are meaningful afterwards.
+  template<class W2 = weight_type, class Queue = DijkstraLazyHeap, class H> constexpr ShortestPathResult<W2> shortest_path_astar(u32 s, u32 t, H&& h) const {
+    const u32 n = derived().vertex_count();
+    const auto inf = std::numeric_limits<W2>::max();
+    ShortestPathResult<W2> res(inf, n);
+    Vec<W2> hv(n);
+    typename Queue::template queue_type<W2> pq(n, derived().edge_count());
+    res.dist_[s] = W2{};
+    hv[s] = static_cast<W2>(std::invoke(h, s));
+    pq.push(hv[s], s);
+    while(!pq.empty()) {
+      const auto [f, v] = pq.pop();
+      const W2 d = res.dist_[v];
+      if(f != d + hv[v]) continue;
+      if(v == t) break;
+      for(const auto& e : derived()[v]) {
+        const u32 to = e.to();
+        const W2 nd = d + static_cast<W2>(e.weight());
+        if(nd < res.dist_[to]) {
+          if(res.dist_[to] == inf) hv[to] = static_cast<W2>(std::invoke(h, to));
+          res.dist_[to] = nd;
+          res.prev_[to] = v;
+          pq.push(nd + hv[to], to);
+        }
+      }
+    }
+    return res;
+  }
+  // Bidirectional Dijkstra from s to t. rev must be the reverse graph: rev[v] lists an edge to u for every edge u -> v. The two searches alternate and stop once the settled radii add up to the best s-t path seen. dist(t) and path(t) are exact, and so is dist(v) for every v on path(t).
+  template<class W2 = weight_type, class Queue = DijkstraLazyHeap, class R> constexpr ShortestPathResult<W2> shortest_path_bidirectional_dijkstra(u32 s, u32 t, const R& rev) const {
+    const u32 n = derived().vertex_count();
+    constexpr u32 npos = 0xffffffff;
+    const auto inf = std::numeric_limits<W2>::max();
+    ShortestPathResult<W2> res(inf, n);
+    Vec<W2> dist_b(n, inf);
+    Vec<u32> next_b(n, npos);
+    using queue_type = typename Queue::template queue_type<W2>;
+    queue_type pq_f(n, derived().edge_count()), pq_b(n, derived().edge_count());
+    res.dist_[s] = W2{}, dist_b[t] = W2{};
+    pq_f.push(W2{}, s), pq_b.push(W2{}, t);
+    // The best path found so far is s ~> meet_a -> meet_b ~> t.
+    W2 best = s == t ? W2{} : inf, radius_f{}, radius_b{};
+    u32 meet_a = npos, meet_b = npos;
+    for(bool forward = true; s != t && !pq_f.empty() && !pq_b.empty(); forward = !forward) {
+      auto& pq = forward ? pq_f : pq_b;
+      auto& dist = forward ? res.dist_ : dist_b;
+      auto& other = forward ? dist_b : res.dist_;
+      const auto [d, v] = pq.pop();
+      if(d != dist[v]) continue;
+      if(best != inf && d + (forward ? radius_b : radius_f) >= best) break;
+      (forward ? radius_f : radius_b) = d;
+      auto relax = [&](u32 to, const W2& w) {
+        const W2 nd = d + w;
+        if(nd < dist[to]) {
+          dist[to] = nd;
+          (forward ? res.prev_[to] : next_b[to]) = v;
+          pq.push(nd, to);
         }
+        if(other[to] != inf && nd + other[to] < best) {
+          best = nd + other[to];
+          meet_a = forward ? v : to, meet_b = forward ? to : v;
+        }
+      };
+      if(forward) {
+        for(const auto& e : derived()[v]) relax(e.to(), static_cast<W2>(e.weight()));
+      } else {
+        for(const auto& e : rev[v]) relax(e.to(), static_cast<W2>(e.weight()));
+      }
+    }
+    if(meet_a != npos) {
+      for(u32 cur = meet_a, x = meet_b; cur != t; cur = x, x = next_b[x]) {
+        res.prev_[x] = cur;
+        res.dist_[x] = best - dist_b[x];
       }
     }
     return res;
@@ -404,6 +885,102 @@ public:
     drain_neg();
     return res;
   }
+protected:
+  // Direction-optimizing BFS (Beamer et al.). Levels whose frontier touches few edges are expanded top-down from a vertex list; once the frontier's edges outnumber a fraction of the unexplored ones, the unvisited vertices instead scan their in-neighbours against a frontier bitmap and stop at the first hit. in(v, f) must call f(u) for each in-neighbour u of v until f returns true.
+  template<class In> ShortestPathResult<u32> shortest_path_bfs_direction_optimizing(u32 s, u32 threads, In&& in) const {
+    constexpr u32 inf = std::numeric_limits<u32>::max();
+    constexpr u32 alpha = 14, beta = 24, grain = 1u << 12;
+    const auto& g = derived();
+    const u32 n = g.vertex_count();
+    ShortestPathResult<u32> res(inf, n);
+    if(n == 0) return res;
+    if(threads == 0) threads = 1;
+    auto& dist = res.dist_;
+    auto& prev = res.prev_;
+    // Runs f(t, k) for t in [0, k) on k threads, where k grows with the amount of work so that small levels stay on the calling thread.
+    auto run = [threads](u32 work, auto&& f) {
+      const u32 k = work / grain == 0 ? 1 : work / grain < threads ? work / grain : threads;
+      Vec<std::thread> th;
+      th.reserve(k - 1);
+      for(u32 t = 1; t != k; ++t) th.emplace_back([&f, t, k] { f(t, k); });
+      f(0, k);
+      for(auto& x : th) x.join();
+      return k;
+    };
+    Vec<u32> deg(n);
+    u64 mu = 0;
+    for(u32 v = 0; v != n; ++v) mu += deg[v] = std::ranges::size(g[v]);
+    const u32 words = (n + 63) / 64;
+    Vec<u64> front(words), next(words);
+    Vec<u32> cur{s}, local_nf(threads);
+    Vec<Vec<u32>> local(threads);
+    Vec<u64> local_mf(threads);
+    dist[s] = 0;
+    u64 mf = deg[s];
+    mu -= mf;
+    u32 nf = 1;
+    bool bottom_up = false;
+    for(u32 level = 0; nf != 0; ++level) {
+      if(!bottom_up && mf > mu / alpha) {
+        bottom_up = true;
+        front.assign(words, 0);
+        for(u32 v : cur) front[v / 64] |= u64(1) << (v % 64);
+      } else if(bottom_up && nf < n / beta) {
+        bottom_up = false;
+        cur.clear();
+        for(u32 i = 0; i != words; ++i)
+          for(u64 b = front[i]; b != 0; b &= b - 1) cur.push_back(i * 64 + std::countr_zero(b));
+      }
+      local_mf.assign(threads, 0), local_nf.assign(threads, 0);
+      if(bottom_up) {
+        run(n, [&](u32 t, u32 k) {
+          u64 m = 0;
+          u32 c = 0;
+          for(u32 i = u64(words) * t / k, e = u64(words) * (t + 1) / k; i != e; ++i) {
+            u64 bits = 0;
+            for(u32 v = i * 64, ve = v + 64 < n ? v + 64 : n; v != ve; ++v) {
+              if(dist[v] != inf) continue;
+              in(v, [&](u32 u) {
+                if(!(front[u / 64] >> (u % 64) & 1)) return false;
+                dist[v] = level + 1, prev[v] = u;
+                bits |= u64(1) << (v % 64);
+                m += deg[v], ++c;
+                return true;
+              });
+            }
+            next[i] = bits;
+          }
+          local_mf[t] = m, local_nf[t] = c;
+        });
+        std::swap(front, next);
+      } else {
+        const u32 k = run(cur.size(), [&](u32 t, u32 k) {
+          auto& out = local[t];
+          out.clear();
+          u64 m = 0;
+          for(u32 i = u64(cur.size()) * t / k, e = u64(cur.size()) * (t + 1) / k; i != e; ++i) {
+            const u32 v = cur[i];
+            for(const auto& ed : g[v]) {
+              const u32 to = ed.to();
+              std::atomic_ref<u32> d(dist[to]);
+              u32 expected = inf;
+              if(d.load(std::memory_order_relaxed) != inf || !d.compare_exchange_strong(expected, level + 1, std::memory_order_relaxed)) continue;
+              prev[to] = v;
+              out.push_back(to);
+              m += deg[to];
+            }
+          }
+          local_mf[t] = m, local_nf[t] = out.size();
+        });
+        cur.clear();
+        for(u32 t = 0; t != k; ++t) cur.insert(cur.end(), local[t].begin(), local[t].end());
+      }
+      mf = 0, nf = 0;
+      for(u32 t = 0; t != threads; ++t) mf += local_mf[t], nf += local_nf[t];
+      mu -= mf;
+    }
+    return res;
+  }
 };
 template<class D, class W> class DirectedGraphInterface : public GraphInterface<D, W> {
   constexpr D& derived() noexcept { return *static_cast<D*>(this); }
@@ -412,6 +989,28 @@ public:
   using edge_type = Edge<W>;
   using weight_type = typename edge_type::weight_type;
   constexpr static bool is_weighted = edge_type::is_weighted;
+  // Direction-optimizing BFS from s on up to threads threads. rev must be the reverse graph, e.g. reversed(), whose lists the bottom-up steps scan for in-neighbours; build it once and reuse it across searches. The distances equal those of shortest_path_bfs(s), but among parents on the same level the recorded one may vary between runs.
+  template<class R> auto shortest_path_bfs_parallel(u32 s, const R& rev, u32 threads = std::thread::hardware_concurrency()) const {
+    return this->shortest_path_bfs_direction_optimizing(s, threads, [&rev](u32 v, auto&& f) {
+      for(const auto& e : rev[v])
+        if(f(e.to())) return;
+    });
+  }
+  // The graph with every edge reversed, frozen. It is the reverse graph expected by shortest_path_bidirectional_dijkstra and shortest_path_bfs_parallel.
+  constexpr D reversed() const {
+    const auto& g = derived();
+    const u32 n = g.vertex_count();
+    D res(n);
+    res.reserve(g.edge_count());
+    for(u32 v = 0; v != n; ++v) {
+      for(const auto& e : g[v]) {
+        if constexpr(is_weighted) res.connect(e.to(), v, e.weight());
+        else res.connect(e.to(), v);
+      }
+    }
+    res.freeze();
+    return res;
+  }
   constexpr Vec<u32> indegree() const {
     const u32 n = derived().vertex_count();
     Vec<u32> deg(n, 0);
@@ -451,14 +1050,15 @@ public:
   template<class Comp = Less> constexpr Vec<u32> minimum_topological_sort(Comp comp = Comp()) const {
     const u32 n = derived().vertex_count();
     Vec<u32> indeg = derived().indegree();
-    Heap<u32, Comp> heap(comp);
+    auto rev = [&comp](u32 a, u32 b) { return std::invoke(comp, b, a); };
+    Heap<u32, decltype(rev)> heap(rev);
     for(u32 i = 0; i != n; ++i)
       if(indeg[i] == 0) heap.push(i);
     Vec<u32> res;
     res.reserve(n);
     while(!heap.empty()) {
-      const u32 v = heap.min();
-      heap.pop_min();
+      const u32 v = heap.top();
+      heap.pop();
       res.push_back(v);
       for(const auto& e : derived()[v]) {
         const u32 to = e.to();
@@ -552,6 +1152,16 @@ public:
   using edge_type = Edge<W>;
   using weight_type = typename edge_type::weight_type;
   constexpr static bool is_weighted = edge_type::is_weighted;
+  // Direction-optimizing BFS from s on up to threads threads. The distances equal those of shortest_path_bfs(s), but among parents on the same level the recorded one may vary between runs.
+  auto shortest_path_bfs_parallel(u32 s, u32 threads = std::thread::hardware_concurrency()) const {
+    return this->shortest_path_bfs_direction_optimizing(s, threads, [this](u32 v, auto&& f) {
+      for(const auto& e : derived()[v])
+        if(f(e.to())) return;
+    });
+  }
+  using GraphInterface<D, W>::shortest_path_bidirectional_dijkstra;
+  // An undirected graph is its own reverse.
+  template<class W2 = weight_type, class Queue = DijkstraLazyHeap> constexpr auto shortest_path_bidirectional_dijkstra(u32 s, u32 t) const { return this->template shortest_path_bidirectional_dijkstra<W2, Queue>(s, t, derived()); }
   constexpr Vec<u32> degree() const {
     const u32 n = derived().vertex_count();
     Vec<u32> deg(n);
@@ -661,12 +1271,24 @@ template<class W = std::monostate> class DirectedGraph : public internal::CRS<W>
 public:
   constexpr DirectedGraph() = default;
   constexpr DirectedGraph(u32 n) : base(n) {}
+  // Reads M lines of "from to" (or "from to weight" if W is not std::monostate) and returns the graph already frozen. `index_base` is subtracted from each vertex index.
+  template<class Stream> constexpr static DirectedGraph from_edges(Stream&& stream, u32 n, u32 m, u32 index_base = 0) {
+    DirectedGraph res;
+    res.template assign_edge_list<false>(stream, n, m, index_base);
+    return res;
+  }
 };
 template<class W = std::monostate> class UndirectedGraph : public internal::CRS<W>, public internal::UndirectedGraphInterface<UndirectedGraph<W>, W> {
   using base = internal::CRS<W>;
 public:
   constexpr UndirectedGraph() = default;
   constexpr UndirectedGraph(u32 n) : base(n) {}
+  // Reads M lines of "a b" (or "a b weight" if W is not std::monostate) and returns the graph already frozen. `index_base` is subtracted from each vertex index.
+  template<class Stream> constexpr static UndirectedGraph from_edges(Stream&& stream, u32 n, u32 m, u32 index_base = 0) {
+    UndirectedGraph res;
+    res.template assign_edge_list<true>(stream, n, m, index_base);
+    return res;
+  }
   constexpr void connect(u32 a, u32 b) {
     base::connect(a, b);
     base::connect(b, a);
@@ -3,18 +3,25 @@
 #include "Parser.hpp"
 #include "TypeDef.hpp"
 #include "Util.hpp"
+#include "Vec.hpp"
 #include "internal/UtilMacro.hpp"
+#include <atomic>
+#include <cerrno>
 #include <concepts>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
+#include <memory>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <unistd.h>
 #include <utility>
 #if defined(__linux__)
+#include <fcntl.h>    // open, fcntl
 #include <sys/mman.h> // mmap
 #include <sys/stat.h> // stat, fstat
+#include <sys/uio.h>  // writev
 #endif
 namespace gsh {
 namespace internal { template<class D> class IstreamInterface; }
@@ -87,6 +94,32 @@ template<class D> class IstreamInterface {
   constexpr D& derived() { return *static_cast<D*>(this); }
 public:
   template<class T, class... Types> [[nodiscard]] constexpr auto read() { return ParsingChain<D, TypeArr<T, Types...>>(derived(), std::tuple<>()); }
+  // Parses n values of type T into out. For u32/u64 on x86-64 CPUs with AVX2, a vectorized tokenizer handles everything except the few tokens near the end of the buffer.
+  template<class T> constexpr void read_n(u32 n, T* out) {
+    D& s = derived();
+    u32 i = 0;
+#ifdef GSH_INTERNAL_PARSER_HAS_AVX2
+    if constexpr(std::same_as<T, u32> || std::same_as<T, u64>) {
+      if(!std::is_constant_evaluated() && internal::HasAVX2()) {
+        while(i != n) {
+          s.reload(64);
+          const c8 *first = s.current(), *p = first;
+          i += internal::ParseUnsignedNAVX2(p, first + s.avail(), out + i, n - i);
+          s.skip(p - first);
+          if(i == n) break;
+          while(true) {
+            s.reload(1);
+            if(s.avail() == 0 || static_cast<u8>(*s.current() - '0') < 10) break;
+            s.skip(1);
+          }
+          out[i++] = Parser<T>()(s);
+        }
+        return;
+      }
+    }
+#endif
+    for(; i != n; ++i) out[i] = Parser<T>()(s);
+  }
 };
 }
 }
@@ -164,9 +197,102 @@ public:
   const c8* current() const { return cur; }
   void skip(u32 n) { cur += n; }
 };
+// Reads with a background thread into two alternating buffers, so read(2) overlaps with parsing. Intended for piped input where MmapReader cannot be used.
+// When the current buffer runs out, only the unconsumed tail (a partial token) is copied into a small pad in front of the next buffer instead of memmoving the whole buffer.
+template<u32 Bufsize = (1 << 18)> class AsyncReader : public internal::IstreamInterface<AsyncReader<Bufsize>> {
+  constexpr static u32 Pad = 128;
+  // Shared with the reader thread, which is detached on destruction because it may be blocked in read().
+  struct shared_state {
+    c8 buf[2][Pad + Bufsize + 1];
+    u32 len[2] = {};
+    std::atomic<u32> full[2] = {0, 0};
+    std::atomic<bool> stop = false;
+    i32 fd = 0;
+  };
+  std::shared_ptr<shared_state> state;
+  c8 empty[1] = {};
+  const c8 *cur = empty, *eof = empty;
+  u32 next = 0;
+  bool on_slot = false, finished = false;
+  Vec<c8> spill;
+  static void fill(std::shared_ptr<shared_state> s) {
+    for(u32 i = 0;; i ^= 1) {
+      s->full[i].wait(1, std::memory_order_acquire);
+      if(s->stop.load(std::memory_order_relaxed)) return;
+      const auto r = read(s->fd, s->buf[i] + Pad, Bufsize);
+      s->len[i] = r > 0 ? r : 0;
+      s->full[i].store(1, std::memory_order_release);
+      s->full[i].notify_one();
+      if(r <= 0) return;
+    }
+  }
+  void release(u32 i) {
+    state->full[i].store(0, std::memory_order_release);
+    state->full[i].notify_one();
+  }
+  void advance() {
+    if(finished) return;
+    shared_state& s = *state;
+    s.full[next].wait(0, std::memory_order_acquire);
+    const u32 rem = eof - cur, n = s.len[next];
+    if(n == 0) {
+      finished = true;
+      return;
+    }
+    c8* data = s.buf[next] + Pad;
+    if(rem <= Pad) [[likely]] {
+      std::memcpy(data - rem, cur, rem);
+      cur = data - rem;
+      eof = data + n;
+      *(data + n) = '\0';
+      if(on_slot) release(next ^ 1);
+      on_slot = true;
+    } else {
+      Vec<c8> tmp(rem + n + 1);
+      std::memcpy(tmp.data(), cur, rem);
+      std::memcpy(tmp.data() + rem, data, n);
+      tmp[rem + n] = '\0';
+      if(on_slot) release(next ^ 1);
+      release(next);
+      on_slot = false;
+      spill = std::move(tmp);
+      cur = spill.data();
+      eof = cur + rem + n;
+    }
+    next ^= 1;
+  }
+public:
+  AsyncReader() : AsyncReader(0) {}
+  AsyncReader(i32 filehandle) : state(std::make_shared<shared_state>()) {
+    state->fd = filehandle;
+    std::thread(fill, state).detach();
+  }
+  AsyncReader(const AsyncReader&) = delete;
+  AsyncReader& operator=(const AsyncReader&) = delete;
+  ~AsyncReader() {
+    state->stop.store(true, std::memory_order_relaxed);
+    release(0);
+    release(1);
+  }
+  void reload() {
+    if([&] {
+      auto p = cur;
+      while(*p >= '!') ++p;
+      return p;
+    }() == eof) advance();
+  }
+  void reload(u32 len) {
+    if(avail() < len) [[unlikely]]
+      advance();
+  }
+  u32 avail() const { return eof - cur; }
+  const c8* current() const { return cur; }
+  void skip(u32 n) { cur += n; }
+};
 class StaticStrReader : public internal::IstreamInterface<StaticStrReader> {
   const c8* cur;
 public:
+  constexpr static bool stable_buffer = true;
   constexpr StaticStrReader() {}
   constexpr StaticStrReader(const c8* c) : cur(c) {}
   constexpr void reload() const {}
@@ -194,7 +320,14 @@ public:
     return *this;
   }
   void reload() {
-    [[maybe_unused]] i32 tmp = write(fd, buf, cur - buf);
+    for(const c8* p = buf; p != cur;) {
+      const auto k = write(fd, p, cur - p);
+      if(k <= 0) [[unlikely]] {
+        if(k < 0 && errno == EINTR) continue;
+        break;
+      }
+      p += k;
+    }
     cur = buf;
   }
   void reload(u32 len) {
@@ -220,6 +353,7 @@ class MmapReader : public internal::IstreamInterface<MmapReader> {
   [[maybe_unused]] const i32 fh;
   c8 *buf, *cur, *eof;
 public:
+  constexpr static bool stable_buffer = true;
   MmapReader() : fh(0) {
 #if !defined(__linux__)
     buf = nullptr;
@@ -240,5 +374,284 @@ public:
   u32 avail() const { return eof - cur; }
   const c8* current() const { return cur; }
   void skip(u32 n) { cur += n; }
+  // Parses the next n whitespace-separated tokens as T on multiple threads. The span holding them is located first: a region sized from the token density of the input is split at whitespace and its chunks are counted in parallel, and the region is extended geometrically until it holds n tokens, so the cost does not depend on what follows them. The counted chunks are then parsed straight into their slots of the result, handed out dynamically to balance the threads.
+  template<class T = u32> Vec<T> read_parallel(u32 n, u32 threads = std::thread::hardware_concurrency()) {
+    if(threads == 0) threads = 1;
+    auto workers = [threads](u64 len) { return len < (u64(1) << 16) * threads ? 1u : threads; };
+    auto run = [](u32 k, auto&& f) {
+      Vec<std::thread> th;
+      th.reserve(k - 1);
+      for(u32 i = 1; i != k; ++i) th.emplace_back(f, i);
+      f(0);
+      for(auto& t : th) t.join();
+    };
+    // Tokens are found eight bytes at a time: a token starts at every byte in ['!', 0x7f] that does not follow another one. starts(p, prev) flags the starts in the word at p with the top bit of their byte, where prev flags the last byte of the previous word.
+    auto starts = [](const c8* p, u64& prev) {
+      u64 x;
+      MemoryCopy(&x, p, 8);
+      const u64 tok = ((x & 0x7f7f7f7f7f7f7f7f) + 0x5f5f5f5f5f5f5f5f) & ~x & 0x8080808080808080;
+      const u64 s = tok & ~(tok << 8 | prev);
+      prev = tok >> 56;
+      return s;
+    };
+    // Counts the starts in the next k <= 255 words, summing them in byte lanes so no popcount is needed.
+    auto block = [&](const c8* p, u32 k, u64& prev) {
+      u64 acc = 0;
+      for(u32 i = 0; i != k; ++i, p += 8) acc += starts(p, prev) >> 7;
+      acc = (acc & 0x00ff00ff00ff00ff) + (acc >> 8 & 0x00ff00ff00ff00ff);
+      return static_cast<u32>(acc * 0x0001000100010001 >> 48);
+    };
+    // Counts the tokens in [lo, hi).
+    auto count = [&](const c8* lo, const c8* hi) {
+      u32 c = 0;
+      u64 prev = 0;
+      for(u64 k; (k = (hi - lo) / 8) != 0; lo += 8 * k) {
+        k = k < 255 ? k : 255;
+        c += block(lo, k, prev);
+      }
+      for(bool in = prev != 0; lo != hi; ++lo) {
+        const bool tok = *lo >= '!';
+        c += tok & !in;
+        in = tok;
+      }
+      return c;
+    };
+    // Returns the end of the r-th token (r >= 1) in [lo, hi), which must hold at least r tokens.
+    auto seek = [&](const c8* lo, const c8* hi, u32 r) {
+      u64 prev = 0;
+      for(u64 k; (k = (hi - lo) / 8) != 0; lo += 8 * k) {
+        k = k < 255 ? k : 255;
+        u64 tmp = prev;
+        const u32 s = block(lo, k, tmp);
+        if(s >= r) break;
+        r -= s, prev = tmp;
+      }
+      for(; hi - lo >= 8; lo += 8) {
+        u64 tmp = prev;
+        const u32 s = std::popcount(starts(lo, tmp));
+        if(s >= r) break;
+        r -= s, prev = tmp;
+      }
+      for(bool in = prev != 0;; ++lo) {
+        const bool tok = lo != hi && *lo >= '!';
+        if(!tok && in && r == 0) return lo;
+        r -= tok & !in;
+        in = tok;
+      }
+    };
+    // Chunk j spans [bound[j], bound[j + 1]) and holds the tokens cnt[j] to cnt[j + 1]. Chunk boundaries fall on whitespace, so no token straddles two chunks.
+    Vec<const c8*> bound{cur};
+    Vec<u32> cnt{0};
+    if(n != 0) {
+      const c8* sample = eof - cur > (1 << 16) ? cur + (1 << 16) : eof;
+      const u32 c = count(cur, sample);
+      u64 step = c == 0 ? (1 << 16) : (sample - cur) * u64(n) / c / 8 * 9 + 64;
+      for(const c8* lo = cur;; step *= 2) {
+        const c8* hi = eof - lo > step ? lo + step : eof;
+        while(hi != eof && *hi >= '!') ++hi;
+        const u32 w = workers(hi - lo), k = w == 1 ? 1 : 4 * w;
+        Vec<const c8*> b(k + 1);
+        b[0] = lo, b[k] = hi;
+        for(u32 j = 1; j != k; ++j) {
+          const c8* p = lo + (hi - lo) / k * j;
+          if(p < b[j - 1]) p = b[j - 1];
+          while(p != hi && *p >= '!') ++p;
+          b[j] = p;
+        }
+        Vec<u32> c(k);
+        run(w, [&](u32 t) {
+          for(u32 j = t; j < k; j += w) c[j] = count(b[j], b[j + 1]);
+        });
+        for(u32 j = 0; j != k && cnt.back() != n; ++j) {
+          if(cnt.back() + c[j] < n) {
+            bound.push_back(b[j + 1]), cnt.push_back(cnt.back() + c[j]);
+            continue;
+          }
+          // The n-th token ends inside this chunk.
+          bound.push_back(seek(b[j], b[j + 1], n - cnt.back())), cnt.push_back(n);
+        }
+        if(cnt.back() == n) break;
+        if(hi == eof) [[unlikely]]
+          throw Exception("gsh::MmapReader::read_parallel / The input does not contain enough tokens. ( n=", n, ", found=", cnt.back(), " )");
+        lo = hi;
+      }
+    }
+    const u32 m = bound.size() - 1, w = workers(bound.back() - cur);
+    Vec<T> res(n);
+    std::atomic<u32> next = 0;
+    run(w < m ? w : m == 0 ? 1 : m, [&](u32) {
+      for(u32 j; (j = next.fetch_add(1, std::memory_order_relaxed)) < m;) {
+        StaticStrReader rd(bound[j]);
+        T* out = res.data() + cnt[j];
+        for(u32 i = 0, k = cnt[j + 1] - cnt[j]; i != k; ++i) {
+          while(*rd.current() < '!') rd.skip(1);
+          out[i] = Parser<T>()(rd);
+        }
+      }
+    });
+    // Like the sequential parsers, consume the separator that follows the last token.
+    if(n != 0) cur = const_cast<c8*>(bound.back() != eof ? bound.back() + 1 : eof);
+    return res;
+  }
+};
+// Writer for large outputs. When the descriptor refers to a regular file, the output is written straight into a shared mapping of the file; otherwise filled buffers are queued and handed to the kernel together with one writev call. The mapped file is extended with ftruncate at most Window bytes ahead of the output, so a process that dies before close leaves at most that much zero padding behind.
+template<u32 Bufsize = (1 << 18), u32 Batch = 16> class MmapWriter : public internal::OstreamInterface<MmapWriter<Bufsize, Batch>> {
+  static_assert(Batch != 0 && Batch <= 1024, "gsh::MmapWriter / Batch must be in [1, 1024].");
+  constexpr static u64 Chunk = u64(1) << 26, Window = u64(1) << 20;
+  i32 fd = 1, mfd = -1;
+  c8 *cur = nullptr, *eof = nullptr;
+  c8* map = nullptr;
+  u64 map_off = 0, map_len = 0, orig = 0, start = 0, file_len = 0, page = 4096;
+  Vec<c8> buf;
+  u32 idx = 0;
+  u32 len[Batch] = {};
+  void init() {
+#if defined(__linux__)
+    struct stat st;
+    const i64 pos = lseek(fd, 0, SEEK_CUR);
+    const i32 fl = fcntl(fd, F_GETFL);
+    if(pos >= 0 && fl >= 0 && !(fl & O_APPEND) && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+      if((fl & O_ACCMODE) == O_RDWR) mfd = dup(fd);
+      else {
+        // A shared writable mapping needs read access, so reopen the same file for reading and writing.
+        c8 path[32] = "/proc/self/fd/";
+        StaticStrWriter w(path + 14);
+        w.write(static_cast<u32>(fd));
+        *w.current() = '\0';
+        mfd = open(path, O_RDWR | O_CLOEXEC);
+      }
+      if(mfd >= 0) {
+        page = sysconf(_SC_PAGESIZE);
+        orig = file_len = st.st_size, start = pos;
+        if(remap(pos, 0)) return;
+        unmap(pos);
+      }
+    }
+#endif
+    init_buffer();
+  }
+  void init_buffer() {
+    if(buf.empty()) buf = Vec<c8>(Batch * Bufsize);
+    idx = 0;
+    cur = buf.data(), eof = cur + Bufsize;
+  }
+#if defined(__linux__)
+  u64 position() const { return map_off + (cur - map); }
+  // Makes [pos, pos + need) writable inside the current mapping. Stores past the end of the file raise SIGBUS, so eof never passes file_len.
+  bool extend(u64 pos, u64 need) {
+    // The lead grows with the output, so small outputs stay within a page of their size.
+    const u64 lead = pos - start + page < Window ? pos - start + page : Window;
+    const u64 map_end = map_off + map_len, want = pos + need + lead;
+    const u64 end = want < map_end ? want : map_end;
+    if(end > file_len) {
+      if(ftruncate(mfd, end) != 0) return false;
+      file_len = end;
+    }
+    cur = map + (pos - map_off), eof = map + ((file_len < map_end ? file_len : map_end) - map_off);
+    return true;
+  }
+  bool remap(u64 pos, u64 need) {
+    if(map != nullptr) munmap(map, map_len), map = nullptr;
+    map_off = pos & ~(page - 1);
+    map_len = (pos - map_off + need + Chunk + page - 1) & ~(page - 1);
+    void* p = mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, mfd, map_off);
+    if(p == MAP_FAILED) return false;
+    map = static_cast<c8*>(p);
+    return extend(pos, need);
+  }
+  void unmap(u64 pos) {
+    if(map != nullptr) munmap(map, map_len), map = nullptr;
+    [[maybe_unused]] i32 tmp = ftruncate(mfd, pos < orig ? orig : pos);
+    lseek(fd, pos, SEEK_SET);
+    ::close(mfd);
+    mfd = -1;
+  }
+#endif
+  void grow(u32 n) {
+#if defined(__linux__)
+    if(mfd >= 0) {
+      const u64 pos = position();
+      if(pos + n <= map_off + map_len ? extend(pos, n) : remap(pos, n)) return;
+      unmap(pos);
+      init_buffer();
+      return;
+    }
+#endif
+    if(idx + 1 == Batch) flush();
+    else len[idx] = cur - (buf.data() + idx * Bufsize), ++idx, cur = buf.data() + idx * Bufsize, eof = cur + Bufsize;
+  }
+  void flush() {
+    len[idx] = cur - (buf.data() + idx * Bufsize);
+    const u32 m = idx + 1;
+#if defined(__linux__)
+    struct iovec iov[Batch];
+    u32 cnt = 0;
+    for(u32 i = 0; i != m; ++i)
+      if(len[i] != 0) iov[cnt++] = {buf.data() + i * Bufsize, len[i]};
+    for(struct iovec* v = iov; cnt != 0;) {
+      const auto k = writev(fd, v, cnt);
+      if(k <= 0) [[unlikely]] {
+        if(k < 0 && errno == EINTR) continue;
+        break;
+      }
+      // Partial write: drop the fully written buffers and advance into the first unfinished one.
+      for(u64 r = k; r != 0;) {
+        if(r >= v->iov_len) r -= v->iov_len, ++v, --cnt;
+        else v->iov_base = static_cast<c8*>(v->iov_base) + r, v->iov_len -= r, r = 0;
+      }
+    }
+#else
+    for(u32 i = 0; i != m; ++i) {
+      for(const c8 *p = buf.data() + i * Bufsize, *e = p + len[i]; p != e;) {
+        const auto k = ::write(fd, p, e - p);
+        if(k <= 0) [[unlikely]] {
+          if(k < 0 && errno == EINTR) continue;
+          break;
+        }
+        p += k;
+      }
+    }
+#endif
+    idx = 0;
+    cur = buf.data(), eof = cur + Bufsize;
+  }
+public:
+  MmapWriter() { init(); }
+  MmapWriter(i32 filehandle) : fd(filehandle) { init(); }
+  MmapWriter(const MmapWriter&) = delete;
+  MmapWriter& operator=(const MmapWriter&) = delete;
+  ~MmapWriter() {
+#if defined(__linux__)
+    if(mfd >= 0) {
+      unmap(position());
+      return;
+    }
+#endif
+    flush();
+  }
+  // Writes out everything produced so far and, in the mapped mode, unmaps the file and trims it to the written size. The writer stays usable and continues with buffered writes.
+  void close() {
+#if defined(__linux__)
+    if(mfd >= 0) {
+      unmap(position());
+      init_buffer();
+      return;
+    }
+#endif
+    flush();
+  }
+  bool is_mapped() const { return mfd >= 0; }
+  void reload() {
+    if(mfd >= 0) {
+      if(eof - cur < Bufsize) grow(Bufsize);
+    } else flush();
+  }
+  void reload(u32 n) {
+    if(eof - cur < n) [[unlikely]]
+      grow(n);
+  }
+  u32 avail() const { return eof - cur; }
+  c8* current() { return cur; }
+  void skip(u32 n) { cur += n; }
 };
 }
@@ -3,12 +3,73 @@
 #include "Int128.hpp"
 #include "TypeDef.hpp"
 #include "Util.hpp"
+#include "Vec.hpp"
 #include "internal/UtilMacro.hpp"
 #include <bit>
 #include <limits>
 #include <type_traits>
+#include <utility>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define GSH_INTERNAL_MODINT_HAS_AVX2
+#endif
 namespace gsh {
 namespace internal {
+#ifdef GSH_INTERNAL_MODINT_HAS_AVX2
+// Batch arithmetic on plain residues modulo an odd mod below 2^31. Products go through 8-lane Montgomery reduction: y is moved into Montgomery form first, so that reducing x * y R gives the plain x * y. Each function handles the leading multiple of 8 elements and returns its length.
+class ModintVec32AVX2 {
+  u32 mod_, ninv, r2;
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static __m256i load(const u32* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE static void store(u32* p, __m256i x) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x); }
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE __m256i reduce(__m256i x, __m256i y) const {
+    const __m256i m = _mm256_set1_epi32(mod_), ni = _mm256_set1_epi32(ninv);
+    const __m256i pe = _mm256_mul_epu32(x, y), po = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(y, 32));
+    const __m256i re = _mm256_add_epi64(pe, _mm256_mul_epu32(_mm256_mul_epu32(pe, ni), m)), ro = _mm256_add_epi64(po, _mm256_mul_epu32(_mm256_mul_epu32(po, ni), m));
+    const __m256i r = _mm256_blend_epi32(_mm256_srli_epi64(re, 32), ro, 0b10101010);
+    return _mm256_min_epu32(r, _mm256_sub_epi32(r, m));
+  }
+  __attribute__((target("avx2"))) GSH_INTERNAL_INLINE __m256i add(__m256i x, __m256i y) const {
+    const __m256i r = _mm256_add_epi32(x, y);
+    return _mm256_min_epu32(r, _mm256_sub_epi32(r, _mm256_set1_epi32(mod_)));
+  }
+  constexpr u32 to_mont(u32 x) const { return (static_cast<u64>(x) << 32) % mod_; }
+public:
+  constexpr ModintVec32AVX2(u32 m) : mod_(m), ninv(m), r2(-static_cast<u64>(m) % m) {
+    for(u32 i = 0; i != 4; ++i) ninv *= 2 - m * ninv;
+    ninv = -ninv;
+  }
+  constexpr static bool supported(u32 m) noexcept { return m % 2 == 1 && m < (1u << 31); }
+  __attribute__((target("avx2"))) u32 add(u32* x, const u32* y, u32 n) const {
+    u32 i = 0;
+    for(; i + 8 <= n; i += 8) store(x + i, add(load(x + i), load(y + i)));
+    return i;
+  }
+  __attribute__((target("avx2"))) u32 mul(u32* x, const u32* y, u32 n) const {
+    const __m256i r = _mm256_set1_epi32(r2);
+    u32 i = 0;
+    for(; i + 8 <= n; i += 8) store(x + i, reduce(load(x + i), reduce(load(y + i), r)));
+    return i;
+  }
+  __attribute__((target("avx2"))) u32 mul(u32* x, u32 c, u32 n) const {
+    const __m256i w = _mm256_set1_epi32(to_mont(c));
+    u32 i = 0;
+    for(; i + 8 <= n; i += 8) store(x + i, reduce(load(x + i), w));
+    return i;
+  }
+  __attribute__((target("avx2"))) u32 fma(u32* x, const u32* y, const u32* z, u32 n) const {
+    const __m256i r = _mm256_set1_epi32(r2);
+    u32 i = 0;
+    for(; i + 8 <= n; i += 8) store(x + i, add(reduce(load(x + i), reduce(load(y + i), r)), load(z + i)));
+    return i;
+  }
+  __attribute__((target("avx2"))) u32 fma(u32* x, u32 c, const u32* z, u32 n) const {
+    const __m256i w = _mm256_set1_epi32(to_mont(c));
+    u32 i = 0;
+    for(; i + 8 <= n; i += 8) store(x + i, add(reduce(load(x + i), w), load(z + i)));
+    return i;
+  }
+};
+#endif
 template<class T> concept IsStaticModint = !requires(T x, typename T::value_type m) { x.set(m); };
 template<class T, u32 id, bool IsThreadLocal> class ModintBase {
 protected:
@@ -37,6 +98,17 @@ public:
   template<class U> constexpr ModintInterface(U x) noexcept { operator=(x); }
   constexpr explicit operator value_type() const noexcept { return val(); }
   constexpr static void set_mod(value_type x) { mint().set(x); }
+  // Calls f(kernel) with the arithmetic kernel chosen for the current mod, for impls that provide one. Kernel values are converted with kernel.raw(x.val()) and kernel.val(y).
+  template<class F> static decltype(auto) with_kernel(F&& f) requires requires { mint().with_kernel(f); } { return mint().with_kernel(std::forward<F>(f)); }
+  // Sets the mod to m for the duration of f(kernel) and restores the previous mod afterwards, also when f throws.
+  template<class F> static decltype(auto) with_mod(value_type m, F&& f) requires requires { mint().with_kernel(f); } {
+    struct Restore {
+      T prev;
+      ~Restore() { mint() = prev; }
+    } restore{mint()};
+    mint().set(m);
+    return mint().with_kernel(std::forward<F>(f));
+  }
   constexpr value_type val() const noexcept { return mint().val(val_); }
   constexpr static value_type mod() noexcept { return mint().mod(); }
   template<class U> constexpr ModintInterface& operator=(U x) noexcept {
@@ -49,6 +121,12 @@ public:
   constexpr static ModintInterface zero() noexcept { return construct(mint().zero()); }
   constexpr static ModintInterface one() noexcept { return construct(mint().one()); }
   constexpr static ModintInterface fma(ModintInterface x, ModintInterface y, ModintInterface a) noexcept { return construct(mint().fma(x.val_, y.val_, a.val_)); }
+  // Batch operations over n elements, in place on x: x += y, x *= y, and x = x * y + z. y may also be a single value.
+  static void vec_add(ModintInterface* x, const ModintInterface* y, u32 n) noexcept { mint().vec_add(&x->val_, &y->val_, n); }
+  static void vec_mul(ModintInterface* x, const ModintInterface* y, u32 n) noexcept { mint().vec_mul(&x->val_, &y->val_, n); }
+  static void vec_mul(ModintInterface* x, ModintInterface y, u32 n) noexcept { mint().vec_mul(&x->val_, y.val_, n); }
+  static void vec_fma(ModintInterface* x, const ModintInterface* y, const ModintInterface* z, u32 n) noexcept { mint().vec_fma(&x->val_, &y->val_, &z->val_, n); }
+  static void vec_fma(ModintInterface* x, ModintInterface y, const ModintInterface* z, u32 n) noexcept { mint().vec_fma(&x->val_, y.val_, &z->val_, n); }
   constexpr ModintInterface abs() const noexcept { return construct(mint().abs(val_)); }
   constexpr ModintInterface inv() const noexcept { return construct(mint().inv(val_)); }
   constexpr ModintInterface pow(u64 e) const noexcept { return construct(mint().pow(val_, e)); }
@@ -153,6 +231,48 @@ public:
     return x - y + (x < y) * derived().mod();
   }
   constexpr value_type fma(value_type x, value_type y, value_type z) const noexcept { return derived().add(derived().mul(x, y), z); }
+  // Whether the values are plain residues modulo an odd mod below 2^31 that ModintVec32AVX2 can process on this CPU.
+  constexpr bool vec_avx2() const noexcept { return false; }
+  void vec_add(value_type* x, const value_type* y, u32 n) const noexcept {
+    u32 i = 0;
+#ifdef GSH_INTERNAL_MODINT_HAS_AVX2
+    if constexpr(std::is_same_v<value_type, u32>)
+      if(derived().vec_avx2()) i = ModintVec32AVX2(derived().mod()).add(x, y, n);
+#endif
+    for(; i != n; ++i) x[i] = derived().add(x[i], y[i]);
+  }
+  void vec_mul(value_type* x, const value_type* y, u32 n) const noexcept {
+    u32 i = 0;
+#ifdef GSH_INTERNAL_MODINT_HAS_AVX2
+    if constexpr(std::is_same_v<value_type, u32>)
+      if(derived().vec_avx2()) i = ModintVec32AVX2(derived().mod()).mul(x, y, n);
+#endif
+    for(; i != n; ++i) x[i] = derived().mul(x[i], y[i]);
+  }
+  void vec_mul(value_type* x, value_type y, u32 n) const noexcept {
+    u32 i = 0;
+#ifdef GSH_INTERNAL_MODINT_HAS_AVX2
+    if constexpr(std::is_same_v<value_type, u32>)
+      if(derived().vec_avx2()) i = ModintVec32AVX2(derived().mod()).mul(x, y, n);
+#endif
+    for(; i != n; ++i) x[i] = derived().mul(x[i], y);
+  }
+  void vec_fma(value_type* x, const value_type* y, const value_type* z, u32 n) const noexcept {
+    u32 i = 0;
+#ifdef GSH_INTERNAL_MODINT_HAS_AVX2
+    if constexpr(std::is_same_v<value_type, u32>)
+      if(derived().vec_avx2()) i = ModintVec32AVX2(derived().mod()).fma(x, y, z, n);
+#endif
+    for(; i != n; ++i) x[i] = derived().fma(x[i], y[i], z[i]);
+  }
+  void vec_fma(value_type* x, value_type y, const value_type* z, u32 n) const noexcept {
+    u32 i = 0;
+#ifdef GSH_INTERNAL_MODINT_HAS_AVX2
+    if constexpr(std::is_same_v<value_type, u32>)
+      if(derived().vec_avx2()) i = ModintVec32AVX2(derived().mod()).fma(x, y, z, n);
+#endif
+    for(; i != n; ++i) x[i] = derived().fma(x[i], y, z[i]);
+  }
   constexpr value_type div(value_type x, value_type y) const {
     const value_type iv = derived().inv(y);
     if(derived().same(iv, derived().zero())) [[unlikely]]
@@ -296,6 +416,12 @@ template<u32 mod_> class StaticModint32Impl : public ModintImpl<StaticModint32Im
 public:
   constexpr StaticModint32Impl() noexcept {}
   constexpr u32 mod() const noexcept { return mod_; }
+#ifdef GSH_INTERNAL_MODINT_HAS_AVX2
+  bool vec_avx2() const noexcept {
+    if constexpr(ModintVec32AVX2::supported(mod_)) return HasAVX2();
+    else return false;
+  }
+#endif
   constexpr u32 mul(u32 x, u32 y) const noexcept {
     Assume(x < mod_ && y < mod_);
     return static_cast<u64>(x) * y % mod_;
@@ -318,6 +444,12 @@ template<u32 mod_> requires (std::has_single_bit(mod_ + 1)) class StaticModint32
 public:
   constexpr StaticModint32Impl() noexcept {}
   constexpr u32 mod() const noexcept { return mod_; }
+#ifdef GSH_INTERNAL_MODINT_HAS_AVX2
+  bool vec_avx2() const noexcept {
+    if constexpr(ModintVec32AVX2::supported(mod_)) return HasAVX2();
+    else return false;
+  }
+#endif
   constexpr u32 build(u32 x) const noexcept {
     u32 t = (x >> p) + (x & mod_);
     return t < mod_ ? t : t - mod_;
@@ -392,24 +524,64 @@ template<u64 mod_> requires (mod_ <= 0xffffffff) struct SwitchStaticModint<mod_>
   using type = StaticModint32Impl<mod_>;
 };
 template<u64 mod_> using StaticModintImpl = typename SwitchStaticModint<mod_>::type;
-class DynamicModint32Impl : public ModintImpl<DynamicModint32Impl, u32> {
+// Arithmetic for a 32-bit mod fixed at runtime, one class per kind of mod. DynamicModint32Impl::set picks the kind once, and with_kernel hands the chosen kernel to generic code by value, so a loop written against it compiles to the straight-line arithmetic of a static mod with its constants in registers.
+// Each kernel is a complete ModintImpl with its own representation: convert with raw(x) for a residue x and val(x) on the way out.
+class DynamicModint32Pow2Kernel : public ModintImpl<DynamicModint32Pow2Kernel, u32> {
   u32 mod_ = 0;
-  u64 M_ = 0;
 public:
-  constexpr DynamicModint32Impl() noexcept {}
-  constexpr void set(u32 n) {
-    if(n <= 1) [[unlikely]]
-      throw Exception("gsh::internal::DynamicModint32Impl::set / Mod must be at least 2.");
-    mod_ = n;
-    M_ = std::numeric_limits<u64>::max() / mod_ + 1;
+  constexpr DynamicModint32Pow2Kernel() noexcept {}
+  constexpr explicit DynamicModint32Pow2Kernel(u32 n) noexcept : mod_(n) {}
+  constexpr u32 mod() const noexcept { return mod_; }
+  constexpr u32 build(u32 x) const noexcept { return x & (mod_ - 1); }
+  constexpr u32 build(u64 x) const noexcept { return x & (mod_ - 1); }
+  template<class U> constexpr u32 build(U x) const noexcept { return ModintImpl::build(x); }
+  constexpr u32 mul(u32 x, u32 y) const noexcept {
+    Assume(x < mod_ && y < mod_);
+    return (x * y) & (mod_ - 1);
+  }
+};
+// Montgomery form x 2^32 mod n for odd n, kept in [0, n).
+class DynamicModint32MontgomeryKernel : public ModintImpl<DynamicModint32MontgomeryKernel, u32> {
+  u32 mod_ = 0, ninv = 0, r1 = 0, r2 = 0;
+  constexpr u32 reduce(u64 t) const noexcept {
+    const u32 hi = t >> 32, m = (static_cast<u64>(static_cast<u32>(t) * ninv) * mod_) >> 32;
+    return hi >= m ? hi - m : hi - m + mod_;
+  }
+public:
+  constexpr DynamicModint32MontgomeryKernel() noexcept {}
+  constexpr explicit DynamicModint32MontgomeryKernel(u32 n) noexcept : mod_(n), ninv(n) {
+    for(u32 i = 0; i != 4; ++i) ninv *= 2 - n * ninv;
+    r1 = (1ull << 32) % n, r2 = static_cast<u64>(r1) * r1 % n;
   }
   constexpr u32 mod() const noexcept { return mod_; }
-  constexpr u64 build(u32 x) const noexcept {
+  constexpr u32 val(u32 x) const noexcept { return reduce(x); }
+  constexpr u32 raw(u32 x) const noexcept { return reduce(static_cast<u64>(x) * r2); }
+  constexpr u32 build(u32 x) const noexcept { return raw(x); }
+  constexpr u32 build(u64 x) const noexcept { return raw(x % mod_); }
+  template<class U> constexpr u32 build(U x) const noexcept { return ModintImpl::build(x); }
+  constexpr u32 zero() const noexcept { return 0; }
+  constexpr u32 one() const noexcept { return r1; }
+  constexpr u32 inc(u32 x) const noexcept { return add(x, r1); }
+  constexpr u32 dec(u32 x) const noexcept { return sub(x, r1); }
+  constexpr u32 mul(u32 x, u32 y) const noexcept {
+    Assume(x < mod_ && y < mod_);
+    return reduce(static_cast<u64>(x) * y);
+  }
+};
+// Barrett reduction by a 64-bit reciprocal, for any mod.
+class DynamicModint32BarrettKernel : public ModintImpl<DynamicModint32BarrettKernel, u32> {
+  u32 mod_ = 0;
+  u64 M_ = 0;
+public:
+  constexpr DynamicModint32BarrettKernel() noexcept {}
+  constexpr explicit DynamicModint32BarrettKernel(u32 n) noexcept : mod_(n), M_(std::numeric_limits<u64>::max() / n + 1) {}
+  constexpr u32 mod() const noexcept { return mod_; }
+  constexpr u32 build(u32 x) const noexcept {
     u64 lowbit = M_ * x;
     return (static_cast<u128>(lowbit) * mod_) >> 64;
   }
-  constexpr u64 build(u64 x) const noexcept { return x % mod_; }
-  template<class U> constexpr u64 build(U x) const noexcept { return ModintImpl::build(x); }
+  constexpr u32 build(u64 x) const noexcept { return x % mod_; }
+  template<class U> constexpr u32 build(U x) const noexcept { return ModintImpl::build(x); }
   constexpr u32 mul(u32 x, u32 y) const noexcept {
     Assume(x < mod_ && y < mod_);
     const u64 a = static_cast<u64>(x) * y;
@@ -418,6 +590,35 @@ public:
     return c + (c >= mod_) * mod_;
   }
 };
+// Residues are stored plainly and multiplied by Barrett reduction, which suits every mod. set also prepares the best kernel for the mod: a mask for powers of two, Montgomery for odd mods and Barrett otherwise.
+class DynamicModint32Impl : public ModintImpl<DynamicModint32Impl, u32> {
+  DynamicModint32BarrettKernel barrett;
+  DynamicModint32MontgomeryKernel montgomery;
+  u32 kind = 0; // 0: Barrett, 1: Montgomery, 2: power of two
+public:
+  constexpr DynamicModint32Impl() noexcept {}
+  constexpr void set(u32 n) {
+    if(n <= 1) [[unlikely]]
+      throw Exception("gsh::internal::DynamicModint32Impl::set / Mod must be at least 2.");
+    barrett = DynamicModint32BarrettKernel(n);
+    kind = std::has_single_bit(n) ? 2 : n % 2 == 1;
+    if(kind == 1) montgomery = DynamicModint32MontgomeryKernel(n);
+  }
+  constexpr u32 mod() const noexcept { return barrett.mod(); }
+#ifdef GSH_INTERNAL_MODINT_HAS_AVX2
+  bool vec_avx2() const noexcept { return ModintVec32AVX2::supported(mod()) && HasAVX2(); }
+#endif
+  constexpr u32 build(u32 x) const noexcept { return barrett.build(x); }
+  constexpr u32 build(u64 x) const noexcept { return barrett.build(x); }
+  template<class U> constexpr u32 build(U x) const noexcept { return ModintImpl::build(x); }
+  constexpr u32 mul(u32 x, u32 y) const noexcept { return barrett.mul(x, y); }
+  // Calls f(kernel) with the kernel chosen for the current mod and returns its result. f is instantiated once per kind of kernel.
+  template<class F> constexpr decltype(auto) with_kernel(F&& f) const {
+    if(kind == 1) return f(montgomery);
+    if(kind == 2) return f(DynamicModint32Pow2Kernel(mod()));
+    return f(barrett);
+  }
+};
 class DynamicModint64Impl : public ModintImpl<DynamicModint64Impl, u64> {
   u64 mod_ = 0;
   u128 M_ = 0;
@@ -537,4 +738,26 @@ template<u32 id = 0> using MontgomeryModint64 = internal::ModintInterface<intern
 template<u32 id = 0> using ThreadLocalDynamicModint32 = internal::ModintInterface<internal::DynamicModint32Impl, id, true>;
 template<u32 id = 0> using ThreadLocalDynamicModint64 = internal::ModintInterface<internal::DynamicModint64Impl, id, true>;
 template<u32 id = 0> using ThreadLocalMontgomeryModint64 = internal::ModintInterface<internal::MontgomeryModint64Impl, id, true>;
+// Elementwise x += y, x *= y and x = x * y + z over whole arrays. 32-bit modints with an odd mod below 2^31 run on 8 lanes when AVX2 is available.
+template<class T, u32 id, bool IsThreadLocal> void VecAdd(Vec<internal::ModintInterface<T, id, IsThreadLocal>>& x, const Vec<internal::ModintInterface<T, id, IsThreadLocal>>& y) {
+  if(x.size() != y.size()) [[unlikely]]
+    throw Exception("gsh::VecAdd / The sizes are different. ( x.size()=", x.size(), ", y.size()=", y.size(), " )");
+  internal::ModintInterface<T, id, IsThreadLocal>::vec_add(x.data(), y.data(), x.size());
+}
+template<class T, u32 id, bool IsThreadLocal> void VecMul(Vec<internal::ModintInterface<T, id, IsThreadLocal>>& x, const Vec<internal::ModintInterface<T, id, IsThreadLocal>>& y) {
+  if(x.size() != y.size()) [[unlikely]]
+    throw Exception("gsh::VecMul / The sizes are different. ( x.size()=", x.size(), ", y.size()=", y.size(), " )");
+  internal::ModintInterface<T, id, IsThreadLocal>::vec_mul(x.data(), y.data(), x.size());
+}
+template<class T, u32 id, bool IsThreadLocal> void VecMul(Vec<internal::ModintInterface<T, id, IsThreadLocal>>& x, std::type_identity_t<internal::ModintInterface<T, id, IsThreadLocal>> y) { internal::ModintInterface<T, id, IsThreadLocal>::vec_mul(x.data(), y, x.size()); }
+template<class T, u32 id, bool IsThreadLocal> void VecFma(Vec<internal::ModintInterface<T, id, IsThreadLocal>>& x, const Vec<internal::ModintInterface<T, id, IsThreadLocal>>& y, const Vec<internal::ModintInterface<T, id, IsThreadLocal>>& z) {
+  if(x.size() != y.size() || x.size() != z.size()) [[unlikely]]
+    throw Exception("gsh::VecFma / The sizes are different. ( x.size()=", x.size(), ", y.size()=", y.size(), ", z.size()=", z.size(), " )");
+  internal::ModintInterface<T, id, IsThreadLocal>::vec_fma(x.data(), y.data(), z.data(), x.size());
+}
+template<class T, u32 id, bool IsThreadLocal> void VecFma(Vec<internal::ModintInterface<T, id, IsThreadLocal>>& x, std::type_identity_t<internal::ModintInterface<T, id, IsThreadLocal>> y, const Vec<internal::ModintInterface<T, id, IsThreadLocal>>& z) {
+  if(x.size() != z.size()) [[unlikely]]
+    throw Exception("gsh::VecFma / The sizes are different. ( x.size()=", x.size(), ", z.size()=", z.size(), " )");
+  internal::ModintInterface<T, id, IsThreadLocal>::vec_fma(x.data(), y, z.data(), x.size());
+}
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "Algorithm.hpp" // IWYU pragma: keep
+#include "Exception.hpp"
 #include "Int128.hpp"
 #include "Modint.hpp"
 #include "Numeric.hpp"
@@ -11,7 +12,15 @@
 #include "internal/UtilMacro.hpp"
 #include <bit>
 #include <cmath>
+#include <cstring>
+#include <span>
+#include <thread>
 #include <type_traits>
+#include <utility>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define GSH_INTERNAL_PRIME_HAS_AVX512IFMA
+#endif
 namespace gsh {
 namespace internal {
 struct IsPrime8 {
@@ -146,6 +155,77 @@ struct IsPrime64 {
     } else return test3(2ull, 325ull, 9375ull) && test4(28178ull, 450775ull, 9780504ull, 1795265022ull);
   }
 };
+// The witness sets of IsPrime64 as plain lists. Row i is deterministic below MillerRabinBound[i].
+constexpr u64 MillerRabinBound[5] = {350269456337ull, 55245642489451ull, 7999252175582851ull, 585226005592931977ull, 0xffffffffffffffffull};
+constexpr u32 MillerRabinBaseCount[5] = {3, 4, 5, 6, 7};
+constexpr u64 MillerRabinBases[5][7] = {{4230279247111683200ull, 14694767155120705706ull, 16641139526367750375ull}, {2ull, 141889084524735ull, 1199124725622454117ull, 11096072698276303650ull}, {2ull, 4130806001517ull, 149795463772692060ull, 186635894390467037ull, 3967304179347715805ull}, {2ull, 123635709730000ull, 9233062284813009ull, 43835965440333360ull, 761179012939631437ull, 1263739024124850375ull}, {2ull, 325ull, 9375ull, 28178ull, 450775ull, 9780504ull, 1795265022ull}};
+// The number of Miller-Rabin rounds IsPrimeBatch runs on n, and the base of round r. Below 2^32 a single hashed base as in IsPrime32 suffices.
+constexpr u32 MillerRabinRounds(u64 n) {
+  if(n <= 0xffffffff) return 1;
+  u32 i = 0;
+  while(n >= MillerRabinBound[i]) ++i;
+  return MillerRabinBaseCount[i];
+}
+constexpr u64 MillerRabinBase(u64 n, u32 r) {
+  if(n <= 0xffffffff) return IsPrime32::bases[(static_cast<u32>(n) * 0xad625b89u) >> 24];
+  u32 i = 0;
+  while(n >= MillerRabinBound[i]) ++i;
+  return MillerRabinBases[i][r];
+}
+// Montgomery multiplication modulo an odd n on canonical residues in [0, n). Unlike MontgomeryModint64Impl, which keeps residues below 2 n, this is valid for every odd n below 2^64.
+struct Montgomery64 {
+  u64 n = 0, inv = 0;
+  constexpr Montgomery64() noexcept {}
+  constexpr explicit Montgomery64(u64 n) noexcept : n(n), inv(n) {
+    for(u32 i = 0; i != 6; ++i) inv *= 2 - n * inv;
+  }
+  GSH_INTERNAL_INLINE constexpr u64 mul(u64 x, u64 y) const noexcept {
+    const u128 t = static_cast<u128>(x) * y;
+    const u64 hi = t >> 64, m = (static_cast<u128>(static_cast<u64>(t) * inv) * n) >> 64;
+    return hi < m ? hi - m + n : hi - m;
+  }
+  GSH_INTERNAL_INLINE constexpr u64 add(u64 x, u64 y) const noexcept { return x >= n - y ? x - (n - y) : x + y; }
+  GSH_INTERNAL_INLINE constexpr u64 sub(u64 x, u64 y) const noexcept { return x >= y ? x - y : x - y + n; }
+  constexpr u64 one() const noexcept { return -n % n; }
+  constexpr u64 build(u64 x) const noexcept { return static_cast<u64>((static_cast<u128>(x % n) << 64) % n); }
+};
+// One Miller-Rabin round on each of L lanes in lockstep: res[l] is whether n[l] is a strong probable prime to base a[l]. Every n[l] must be odd and at least 3, and a base divisible by n[l] passes.
+// The lanes have separate moduli and no data dependence, so their 64x64-bit products overlap in the pipeline instead of each waiting on the previous one. d is scanned from the top in 3-bit windows.
+template<u32 L> constexpr void MillerRabinLanes(const u64* n, const u64* a, bool* res) {
+  Montgomery64 mg[L];
+  u64 d[L] = {}, one[L] = {}, x[L] = {}, tab[L][8] = {};
+  u32 s[L] = {}, bits = 0, smax = 0;
+  bool ok[L] = {};
+  for(u32 l = 0; l != L; ++l) {
+    mg[l] = Montgomery64(n[l]);
+    s[l] = std::countr_zero(n[l] - 1), d[l] = (n[l] - 1) >> s[l];
+    bits = std::max<u32>(bits, std::bit_width(d[l])), smax = std::max(smax, s[l]);
+    one[l] = mg[l].one();
+    tab[l][0] = one[l], tab[l][1] = mg[l].build(a[l]);
+  }
+  for(u32 k = 2; k != 8; ++k) {
+    GSH_INTERNAL_UNROLL(8)
+    for(u32 l = 0; l != L; ++l) tab[l][k] = mg[l].mul(tab[l][k - 1], tab[l][1]);
+  }
+  for(u32 l = 0; l != L; ++l) x[l] = one[l];
+  for(u32 i = (bits + 2) / 3 * 3; i != 0;) {
+    i -= 3;
+    GSH_INTERNAL_UNROLL(8)
+    for(u32 l = 0; l != L; ++l) {
+      x[l] = mg[l].mul(x[l], x[l]), x[l] = mg[l].mul(x[l], x[l]), x[l] = mg[l].mul(x[l], x[l]);
+      x[l] = mg[l].mul(x[l], tab[l][d[l] >> i & 7]);
+    }
+  }
+  for(u32 l = 0; l != L; ++l) ok[l] = x[l] == one[l] || x[l] == n[l] - one[l] || tab[l][1] == 0;
+  for(u32 i = 1; i < smax; ++i) {
+    GSH_INTERNAL_UNROLL(8)
+    for(u32 l = 0; l != L; ++l) {
+      x[l] = mg[l].mul(x[l], x[l]);
+      ok[l] |= i < s[l] && x[l] == n[l] - one[l];
+    }
+  }
+  for(u32 l = 0; l != L; ++l) res[l] = ok[l];
+}
 }
 // @brief Prime number determination
 constexpr bool IsPrime(const u64 x) noexcept {
@@ -154,7 +234,99 @@ constexpr bool IsPrime(const u64 x) noexcept {
   } else {
     if(x % 2 == 0 || x % 3 == 0 || x % 5 == 0 || x % 7 == 0 || x % 11 == 0 || x % 13 == 0 || x % 17 == 0 || x % 19 == 0) return false;
     if(x <= 0xffffffff) return internal::IsPrime32::calc(x);
-    else return internal::IsPrime64::calc(x);
+    else if(x < (1ull << 62)) return internal::IsPrime64::calc(x);
+    else {
+      // MontgomeryModint64Impl needs x below 2^62, so the largest inputs run their 7 rounds side by side on canonical residues.
+      const u64 n[7] = {x, x, x, x, x, x, x};
+      bool res[7];
+      internal::MillerRabinLanes<7>(n, internal::MillerRabinBases[4], res);
+      return res[0] && res[1] && res[2] && res[3] && res[4] && res[5] && res[6];
+    }
+  }
+}
+namespace internal {
+#ifdef GSH_INTERNAL_PRIME_HAS_AVX512IFMA
+// The same round on the 8 lanes of a 512-bit register with 52-bit multiply-adds, for moduli below 2^50. Montgomery form uses R = 2^52 and values stay below 2 n.
+class MillerRabinIFMA {
+  __m512i n, ninv;
+  // x y / R, exact since the low 52 bits of x y + q n vanish, so their carry is 1 unless the low half of x y is 0.
+  __attribute__((target("avx512f,avx512ifma"))) GSH_INTERNAL_INLINE __m512i mul(__m512i x, __m512i y) const {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i lo = _mm512_madd52lo_epu64(zero, x, y), hi = _mm512_madd52hi_epu64(zero, x, y);
+    const __m512i q = _mm512_madd52lo_epu64(zero, lo, ninv), t = _mm512_madd52hi_epu64(hi, q, n);
+    return _mm512_mask_add_epi64(t, _mm512_test_epi64_mask(lo, lo), t, _mm512_set1_epi64(1));
+  }
+  __attribute__((target("avx512f,avx512ifma"))) GSH_INTERNAL_INLINE __mmask8 same(__m512i x, __m512i y) const { return _mm512_cmpeq_epi64_mask(x, y) | _mm512_cmpeq_epi64_mask(x, _mm512_add_epi64(y, n)) | _mm512_cmpeq_epi64_mask(y, _mm512_add_epi64(x, n)); }
+public:
+  __attribute__((target("avx512f,avx512ifma"))) void operator()(const u64* m, const u64* a, bool* res) {
+    alignas(64) u64 inv[8], one[8], r2[8], d[8], b[8];
+    u32 s[8], bits = 0, smax = 0;
+    for(u32 l = 0; l != 8; ++l) {
+      u64 t = m[l];
+      for(u32 i = 0; i != 6; ++i) t *= 2 - m[l] * t;
+      inv[l] = -t & ((1ull << 52) - 1);
+      one[l] = (1ull << 52) % m[l], r2[l] = static_cast<u128>(one[l]) * one[l] % m[l];
+      s[l] = std::countr_zero(m[l] - 1), d[l] = (m[l] - 1) >> s[l];
+      bits = std::max<u32>(bits, std::bit_width(d[l])), smax = std::max(smax, s[l]);
+      b[l] = a[l] % m[l];
+    }
+    n = _mm512_loadu_si512(m), ninv = _mm512_load_si512(inv);
+    const __m512i vd = _mm512_load_si512(d), o = _mm512_load_si512(one), mo = _mm512_sub_epi64(n, o);
+    __m512i x = o, c = mul(_mm512_load_si512(b), _mm512_load_si512(r2));
+    for(u32 i = 0; i != bits; ++i) {
+      x = _mm512_mask_mov_epi64(x, _mm512_test_epi64_mask(vd, _mm512_set1_epi64(1ull << i)), mul(x, c));
+      c = mul(c, c);
+    }
+    __mmask8 ok = same(x, o) | same(x, mo);
+    for(u32 i = 1; i < smax; ++i) {
+      x = mul(x, x);
+      __mmask8 live = 0;
+      for(u32 l = 0; l != 8; ++l) live |= static_cast<__mmask8>(i < s[l]) << l;
+      ok |= live & same(x, mo);
+    }
+    for(u32 l = 0; l != 8; ++l) res[l] = (ok >> l & 1) || b[l] == 0;
+  }
+};
+#endif
+}
+// Sets out[i] to IsPrime(x[i]) for every i.
+// Trial division runs per element; the survivors then go through the Miller-Rabin rounds of IsPrime one round at a time, 8 candidates at once, so most composites drop out after the first round and the exponentiations of a group overlap. Groups of moduli below 2^50 use AVX-512 IFMA when the CPU has it.
+inline void IsPrimeBatch(std::span<const u64> x, bool* out) {
+  Vec<u32> cur, next, small, large;
+  for(u32 i = 0; i != x.size(); ++i) {
+    const u64 v = x[i];
+    if(v < 256) out[i] = internal::IsPrime8::calc(v);
+    else if(v % 2 == 0 || v % 3 == 0 || v % 5 == 0 || v % 7 == 0 || v % 11 == 0 || v % 13 == 0 || v % 17 == 0 || v % 19 == 0) out[i] = false;
+    else out[i] = true, cur.push_back(i);
+  }
+#ifdef GSH_INTERNAL_PRIME_HAS_AVX512IFMA
+  const bool ifma = internal::HasAVX512IFMA();
+#else
+  constexpr bool ifma = false;
+#endif
+  // Runs one round on the candidates in idx, padding the last group with copies of its first candidate.
+  const auto run = [&](const Vec<u32>& idx, u32 r, auto&& kernel) {
+    u64 n[8], a[8];
+    bool res[8];
+    for(u32 k = 0; k < idx.size(); k += 8) {
+      const u32 m = idx.size() - k < 8 ? idx.size() - k : 8;
+      for(u32 l = 0; l != 8; ++l) n[l] = x[idx[k + (l < m ? l : 0)]], a[l] = internal::MillerRabinBase(n[l], r);
+      kernel(n, a, res);
+      for(u32 l = 0; l != m; ++l) out[idx[k + l]] = res[l];
+    }
+  };
+  for(u32 r = 0; !cur.empty(); ++r) {
+    small.clear(), large.clear();
+    for(const u32 i : cur) (ifma && x[i] < (1ull << 50) ? small : large).push_back(i);
+#ifdef GSH_INTERNAL_PRIME_HAS_AVX512IFMA
+    if(!small.empty()) run(small, r, internal::MillerRabinIFMA{});
+#endif
+    run(large, r, internal::MillerRabinLanes<8>);
+    next.clear();
+    for(const u32 i : cur) {
+      if(out[i] && r + 1 < internal::MillerRabinRounds(x[i])) next.push_back(i);
+    }
+    cur.swap(next);
   }
 }
 constexpr u32 CountPrimes(u64 N) {
@@ -276,39 +448,538 @@ constexpr u8 table2[]={0,1,0,0,0,0,0,2,0,0,0,4,0,8,0,0,0,16,0,32,0,0,0,64,0,0,0,
   }
   return primes;
 }
+// Smallest prime factors and the tables of Euler's phi, the Mobius function and the number of divisors for the values in [lo, hi), all filled in one sweep. The smallest prime factor is always kept; the other tables are chosen by the bitwise or of Phi, Mobius and DivisorCount.
+// The constructor runs the linear sieve over [0, n], where every composite is written exactly once, from its smallest prime factor. segment(lo, hi) instead sieves only the window by the primes up to sqrt(hi), using O(hi - lo + sqrt(hi)) memory.
+// With any table requested, the values of one integer share a 12-byte entry, so the scattered writes of the sieve touch one cache line per composite instead of one per table. Without, only the u32 smallest prime factors are stored. 0 and 1 have spf 0, and 0 has phi, mobius and divisor_count 0.
+class LinearSieve {
+  struct Entry {
+    u32 spf = 0, phi = 1;
+    u16 d = 1; // the number of divisors, below 2^16 for every u32
+    i8 mu = 1;
+    u8 e = 0; // the exponent of spf
+  };
+  u32 lo_ = 0, hi_ = 0, tables_ = 0;
+  Vec<u32> spf_, primes_;
+  Vec<Entry> t_;
+  template<u32 Tables> void linear() {
+    constexpr bool P = Tables & 1, M = Tables & 2, D = Tables & 4;
+    const u32 n = hi_ - 1;
+    const auto run = [&](auto* const t, auto&& prime, auto&& coprime, auto&& power) {
+      for(u32 i = 2; i <= n; ++i) {
+        if(t[i].spf == 0) primes_.push_back(i), prime(t[i], i);
+        const auto c = t[i];
+        const u32 lim = n / i;
+        const u32* const pr = primes_.data();
+        for(u32 k = 0; k != primes_.size(); ++k) {
+          const u32 p = pr[k];
+          if(p > c.spf || p > lim) break;
+          if(p != c.spf) coprime(t[i * p], c, p);
+          else power(t[i * p], c, p);
+        }
+      }
+    };
+    if constexpr(Tables == 0) {
+      struct S {
+        u32 spf;
+      };
+      static_assert(sizeof(S) == sizeof(u32));
+      run(reinterpret_cast<S*>(spf_.data()), [](S& x, u32 p) { x.spf = p; }, [](S& x, S, u32 p) { x.spf = p; }, [](S& x, S, u32 p) { x.spf = p; });
+    } else {
+      run(
+        t_.data(),
+        [](Entry& x, u32 p) {
+          x.spf = p, x.e = 1;
+          if constexpr(P) x.phi = p - 1;
+          if constexpr(M) x.mu = -1;
+          if constexpr(D) x.d = 2;
+        },
+        [](Entry& x, const Entry& c, u32 p) {
+          x.spf = p, x.e = 1;
+          if constexpr(P) x.phi = c.phi * (p - 1);
+          if constexpr(M) x.mu = -c.mu;
+          if constexpr(D) x.d = c.d * 2;
+        },
+        [](Entry& x, const Entry& c, u32 p) {
+          x.spf = p, x.e = c.e + 1;
+          if constexpr(P) x.phi = c.phi * p;
+          if constexpr(M) x.mu = 0;
+          if constexpr(D) x.d = c.d / (c.e + 1) * (c.e + 2);
+        });
+    }
+  }
+  void init(u32 lo, u32 hi, u32 tables) {
+    lo_ = lo, hi_ = hi, tables_ = tables;
+    if(tables == 0) spf_.assign(hi - lo, 0);
+    else {
+      t_.assign(hi - lo, Entry{});
+      if(lo == 0 && hi != 0) t_[0] = Entry{0, 0, 0, 0, 0};
+    }
+  }
+public:
+  constexpr static u32 Phi = 1, Mobius = 2, DivisorCount = 4;
+  LinearSieve() {}
+  explicit LinearSieve(u32 n, u32 tables = Phi | Mobius | DivisorCount) {
+    if(n == 0xffffffff) [[unlikely]]
+      throw Exception("gsh::LinearSieve::LinearSieve / n must be less than 2^32 - 1.");
+    init(0, n + 1, tables & 7);
+    primes_.reserve(n < 1000 ? 168 : static_cast<u32>(1.1 * n / std::log(n)));
+    [&]<u32... I>(std::integer_sequence<u32, I...>) { ((tables_ == I ? (linear<I>(), 0) : 0), ...); }(std::make_integer_sequence<u32, 8>{});
+  }
+  // The tables for [lo, hi) only. Each prime p up to sqrt(hi) is divided out of its multiples in the window, and what is left over is a prime factor above sqrt(hi).
+  static LinearSieve segment(u32 lo, u32 hi, u32 tables = Phi | Mobius | DivisorCount) {
+    LinearSieve res;
+    if(hi < lo) hi = lo;
+    tables &= 7;
+    res.init(lo, hi, tables);
+    const u32 len = hi - lo;
+    Vec<u32> rem(len);
+    for(u32 k = 0; k != len; ++k) rem[k] = lo + k;
+    const auto entry = [&](u32 k) -> Entry& { return res.t_[k]; };
+    for(const u32 p : EnumeratePrimes(hi == 0 ? 0 : IntSqrt32(hi - 1))) {
+      // Exact division by p is a multiplication by its inverse modulo 2^32, and x is divisible by odd p iff x / p computed that way is at most (2^32 - 1) / p.
+      u32 inv = p;
+      for(u32 i = 0; i != 5; ++i) inv *= 2 - p * inv;
+      const u32 lim = 0xffffffffu / p;
+      for(u32 k = lo % p == 0 ? 0 : p - lo % p; k < len; k += p) {
+        u32 r = rem[k], e = 1, pe = 1;
+        if(r == 0) continue;
+        if(p == 2) e = std::countr_zero(r), r >>= e, pe <<= e - 1;
+        else {
+          r *= inv;
+          while(r * inv <= lim) r *= inv, ++e, pe *= p;
+        }
+        rem[k] = r;
+        if(tables == 0) {
+          if(res.spf_[k] == 0) res.spf_[k] = p;
+          continue;
+        }
+        Entry& x = entry(k);
+        if(x.spf == 0) x.spf = p, x.e = e;
+        if(tables & Phi) x.phi *= pe * (p - 1);
+        if(tables & Mobius) x.mu = e == 1 ? -x.mu : 0;
+        if(tables & DivisorCount) x.d *= e + 1;
+      }
+    }
+    for(u32 k = 0; k != len; ++k) {
+      const u32 r = rem[k];
+      if(r <= 1) continue;
+      if(tables == 0) {
+        if(res.spf_[k] == 0) res.spf_[k] = r;
+        continue;
+      }
+      Entry& x = entry(k);
+      if(x.spf == 0) x.spf = r, x.e = 1;
+      if(tables & Phi) x.phi *= r - 1;
+      if(tables & Mobius) x.mu = -x.mu;
+      if(tables & DivisorCount) x.d *= 2;
+    }
+    for(u32 v = lo < 2 ? 2 : lo; v < hi; ++v) {
+      if(res.spf(v) == v) res.primes_.push_back(v);
+    }
+    return res;
+  }
+  constexpr u32 lo() const noexcept { return lo_; }
+  constexpr u32 hi() const noexcept { return hi_; }
+  // The primes in [lo, hi) in increasing order.
+  constexpr const Vec<u32>& primes() const noexcept { return primes_; }
+  constexpr bool is_prime(u32 v) const { return v >= 2 && spf(v) == v; }
+  constexpr u32 spf(u32 v) const { return tables_ == 0 ? spf_[v - lo_] : t_[v - lo_].spf; }
+  // phi, mobius and divisor_count need their table to have been requested.
+  constexpr u32 phi(u32 v) const { return t_[v - lo_].phi; }
+  constexpr i32 mobius(u32 v) const { return t_[v - lo_].mu; }
+  constexpr u32 divisor_count(u32 v) const { return t_[v - lo_].d; }
+  // The table of an arbitrary multiplicative f over [0, hi), given fpe(p, e) = f(p^e), from the smallest prime factors. f(0) is left as T(). Needs lo = 0.
+  template<class T, class F> Vec<T> multiplicative(F&& fpe) const {
+    if(lo_ != 0) [[unlikely]]
+      throw Exception("gsh::LinearSieve::multiplicative / The sieve must start at 0. ( lo=", lo_, " )");
+    Vec<T> res(hi_);
+    if(hi_ > 1) res[1] = T(1);
+    // rest[i] is i with the powers of its smallest prime factor removed.
+    Vec<u32> rest(hi_);
+    Vec<u8> e(hi_);
+    for(u32 i = 2; i < hi_; ++i) {
+      const u32 p = spf(i), q = i / p;
+      if(spf(q) == p) rest[i] = rest[q], e[i] = e[q] + 1;
+      else rest[i] = q, e[i] = 1;
+      res[i] = rest[i] == 1 ? static_cast<T>(fpe(p, e[i])) : res[rest[i]] * res[i / rest[i]];
+    }
+    return res;
+  }
+};
+namespace internal {
+// Segmented sieve over the mod-30 wheel for the byte range [first, last). Byte k stands for 30 k + {1, 7, 11, 13, 17, 19, 23, 29}, one bit each, and is cleared bit by bit as composites are crossed off. Each segment is pre-sieved by copying a 7 * 11 * 13 byte pattern, so only primes from 17 up to sqrt(30 last) are crossed off one by one.
+// Primes smaller than a segment keep the next byte to clear for each residue class of the cofactor. Larger primes hit a segment at most 8 times, so their pending hits are kept in a ring of buckets indexed by segment instead, and a segment only visits the hits that fall into it.
+class WheelSieve {
+  constexpr static u8 residues[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+  constexpr static u8 bit_index[30] = {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 2, 0, 3, 0, 0, 0, 4, 0, 5, 0, 0, 0, 6, 0, 0, 0, 0, 0, 7};
+  struct Hit {
+    u32 p, pos; // pos = byte offset in its segment * 8 + bit index
+  };
+  const Vec<u32>& primes;
+  u64 base, last, seg_count = 0;
+  u32 len = 0, seg_size, active = 0, small_count = 0;
+  Vec<u32> offset;
+  Vec<Vec<Hit>> bucket;
+  Vec<u8> seg, pattern;
+  // Registers p once its square falls below the end of the current segment, with its first multiple at or after base for each residue class of the cofactor.
+  void activate(u32 p) {
+    const u64 start = 30 * base, q0 = static_cast<u64>(p) * p >= start ? p : (start + p - 1) / p;
+    const bool small = p <= seg_size;
+    small_count += small;
+    for(u32 i = 0; i != 8; ++i) {
+      const u64 q = q0 + (residues[i] + 30 - q0 % 30) % 30, off = p * q / 30 - base;
+      if(small) offset.push_back(static_cast<u32>(off));
+      else bucket[(seg_count + off / seg_size) % bucket.size()].push_back({p, static_cast<u32>(off % seg_size) << 3 | bit_index[p % 30 * residues[i] % 30]});
+    }
+  }
+public:
+  // primes must hold the primes from 17 up to at least sqrt(30 last) in increasing order. seg_size must be less than 2^29.
+  WheelSieve(const Vec<u32>& primes, u64 first, u64 last, u32 seg_size) : primes(primes), base(first), last(last), seg_size(seg_size), seg(seg_size), pattern(1001) {
+    bucket.resize((primes.empty() ? 0 : primes.back() / seg_size) + 2);
+    for(u32 k = 0; k != 1001; ++k) {
+      u8 x = 0;
+      for(u32 i = 0; i != 8; ++i) {
+        const u32 v = 30 * k + residues[i];
+        x |= static_cast<u8>(v % 7 != 0 && v % 11 != 0 && v % 13 != 0) << i;
+      }
+      pattern[k] = x;
+    }
+  }
+  // Sieves the next segment and returns its length in bytes, or 0 once the range is exhausted.
+  u32 next() {
+    if(len != 0) base += len, ++seg_count;
+    if(base >= last) return 0;
+    len = last - base < seg_size ? last - base : seg_size;
+    for(u32 i = 0, ph = base % 1001; i < len; ph = 0) {
+      const u32 c = 1001 - ph < len - i ? 1001 - ph : len - i;
+      std::memcpy(seg.data() + i, pattern.data() + ph, c);
+      i += c;
+    }
+    if(base == 0) seg[0] = (seg[0] & 0b11110000u) | 0b00001110u;
+    const u64 end = 30 * (base + len);
+    for(; active != primes.size() && static_cast<u64>(primes[active]) * primes[active] < end; ++active) activate(primes[active]);
+    u8* const s = seg.data();
+    u32* off = offset.data();
+    for(u32 k = 0; k != small_count; ++k, off += 8) {
+      const u32 p = primes[k], r = p % 30;
+      GSH_INTERNAL_UNROLL(8)
+      for(u32 i = 0; i != 8; ++i) {
+        const u8 mask = ~static_cast<u8>(1u << bit_index[r * residues[i] % 30]);
+        u32 j = off[i];
+        for(; j < len; j += p) s[j] &= mask;
+        off[i] = j - len;
+      }
+    }
+    const u32 bs = bucket.size();
+    Vec<Hit>& cur = bucket[seg_count % bs];
+    for(const Hit h : cur) {
+      const u32 j = h.pos >> 3;
+      s[j] &= ~static_cast<u8>(1u << (h.pos & 7));
+      const u64 nj = static_cast<u64>(j) + h.p;
+      bucket[(seg_count + nj / seg_size) % bs].push_back({h.p, static_cast<u32>(nj % seg_size) << 3 | (h.pos & 7)});
+    }
+    cur.clear();
+    return len;
+  }
+  // Calls f(p) for each prime p in [lo, hi) of the current segment, in increasing order.
+  template<class F> void each(u64 lo, u64 hi, F&& f) const {
+    for(u32 k = 0; k != len; ++k) {
+      for(u32 x = seg[k]; x != 0; x &= x - 1) {
+        const u64 v = 30 * (base + k) + residues[std::countr_zero(x)];
+        if(v >= lo && v < hi) f(v);
+      }
+    }
+  }
+  // The number of primes in [lo, hi) of the current segment.
+  u64 count(u64 lo, u64 hi) const {
+    u64 res = 0;
+    const u64 b = 30 * base;
+    const u32 k0 = lo <= b ? 0 : (lo - b) / 30 + 1, k1 = hi >= 30 * (base + len) ? len : (hi - b) / 30;
+    for(u32 k = k0; k < k1; ++k) res += std::popcount(seg[k]);
+    if(k0 != 0) each(lo, hi < b + 30 * k0 ? hi : b + 30 * k0, [&](u64) { ++res; });
+    if(k1 < len && k1 >= k0) each(b + 30 * k1 > lo ? b + 30 * k1 : lo, hi, [&](u64) { ++res; });
+    return res;
+  }
+};
+// Runs body(t, lo_t, hi_t) on threads pieces of [lo, hi), cut at multiples of 30 * seg_size and in increasing order of t.
+template<class F> void SplitPrimeRange(u64 lo, u64 hi, u32 threads, u32 seg_size, F&& body) {
+  const u64 first = lo / 30, last = hi / 30 + 1, segs = (last - first + seg_size - 1) / seg_size;
+  if(threads == 0) threads = 1;
+  if(threads > segs) threads = segs == 0 ? 1 : segs;
+  Vec<u64> bound(threads + 1);
+  for(u32 t = 0; t <= threads; ++t) bound[t] = t == threads ? hi : t == 0 ? lo : 30 * (first + segs * t / threads * seg_size);
+  Vec<std::thread> th;
+  th.reserve(threads - 1);
+  for(u32 t = 1; t != threads; ++t) th.emplace_back([&, t] { body(t, bound[t], bound[t + 1]); });
+  body(0, bound[0], bound[1]);
+  for(auto& x : th) x.join();
+}
+// The sieving primes from 17 up to sqrt(hi).
+inline Vec<u32> SievingPrimes(u64 hi) {
+  Vec<u32> res = EnumeratePrimes(IntSqrt64(hi));
+  u32 k = 0;
+  while(k != res.size() && res[k] < 17) ++k;
+  res.erase(res.begin(), res.begin() + k);
+  return res;
+}
+template<class F> void ForEachPrimeIn(const Vec<u32>& sp, u64 lo, u64 hi, u32 seg_size, F&& f) {
+  if(lo >= hi) return;
+  for(const u64 p : {2u, 3u, 5u}) {
+    if(p >= lo && p < hi) f(p);
+  }
+  WheelSieve sieve(sp, lo / 30, (hi + 29) / 30, seg_size);
+  while(sieve.next() != 0) sieve.each(lo, hi, f);
+}
+}
+// The default segment size of the segmented sieve in bytes, each covering 30 integers. It should fit in the L2 cache.
+constexpr u32 PrimeSieveSegmentSize = 1u << 18;
+// Calls f(p) for each prime p in [lo, hi) in increasing order with a segmented mod-30 wheel sieve, using O(sqrt(hi) + seg_size) memory.
+template<class F> void ForEachPrime(u64 lo, u64 hi, F&& f, u32 seg_size = PrimeSieveSegmentSize) {
+  if(lo >= hi) return;
+  internal::ForEachPrimeIn(internal::SievingPrimes(hi), lo, hi, seg_size, f);
+}
+// Splits [lo, hi) into threads contiguous pieces and sieves them concurrently. f(t, p) is called on thread t for each prime p of the t-th piece in increasing order; the pieces themselves are in increasing order of t, so per-thread results can be concatenated or merged afterwards.
+template<class F> void ForEachPrimeParallel(u64 lo, u64 hi, F&& f, u32 threads = std::thread::hardware_concurrency(), u32 seg_size = PrimeSieveSegmentSize) {
+  if(lo >= hi) return;
+  const Vec<u32> sp = internal::SievingPrimes(hi);
+  internal::SplitPrimeRange(lo, hi, threads, seg_size, [&](u32 t, u64 l, u64 h) { internal::ForEachPrimeIn(sp, l, h, seg_size, [&](u64 p) { f(t, p); }); });
+}
+// The primes in [lo, hi) in increasing order.
+inline Vec<u64> EnumeratePrimes(u64 lo, u64 hi, u32 threads = 1) {
+  if(lo >= hi) return {};
+  if(threads == 0) threads = 1;
+  Vec<Vec<u64>> part(threads);
+  ForEachPrimeParallel(lo, hi, [&](u32 t, u64 p) { part[t].push_back(p); }, threads);
+  Vec<u64> res;
+  u64 total = 0;
+  for(const auto& x : part) total += x.size();
+  res.reserve(total);
+  for(const auto& x : part) res.insert(res.end(), x.begin(), x.end());
+  return res;
+}
+// The number of primes in [lo, hi), counted by popcount over the sieved segments.
+inline u64 CountPrimes(u64 lo, u64 hi, u32 threads = 1) {
+  if(lo >= hi) return 0;
+  if(threads == 0) threads = 1;
+  const Vec<u32> sp = internal::SievingPrimes(hi);
+  Vec<u64> cnt(threads, 0);
+  internal::SplitPrimeRange(lo, hi, threads, PrimeSieveSegmentSize, [&](u32 t, u64 l, u64 h) {
+    if(l >= h) return;
+    u64 c = 0;
+    for(const u64 p : {2u, 3u, 5u}) c += p >= l && p < h;
+    internal::WheelSieve sieve(sp, l / 30, (h + 29) / 30, PrimeSieveSegmentSize);
+    while(sieve.next() != 0) c += sieve.count(l, h);
+    cnt[t] = c;
+  });
+  u64 res = 0;
+  for(const u64 c : cnt) res += c;
+  return res;
+}
+// Sums of f(p) over the primes p <= v for every v = floor(N / k), computed by Lucy's sieve in O(N^(3/4) / log N). f must be completely multiplicative.
+// prefix(v) must return the sum of f(n) for 2 <= n <= v and value(p) must return f(p), both as T. T is any ring type, e.g. a modint or a wrapping integer.
+template<class T> class PrimeSumTable {
+  u64 n_ = 0;
+  u32 sq = 0;
+  Vec<T> small, large;
+  Vec<u32> primes_;
+  template<bool Fast, class Value> void sieve(Value&& value) {
+    Vec<u64> quot(sq + 1);
+    for(u32 i = 1; i <= sq; ++i) quot[i] = n_ / i;
+    for(const u32 p : primes_) {
+      const T fp = value(p), gp = small[p - 1];
+      const u64 p2 = static_cast<u64>(p) * p, invp = 0xffffffffffffffffu / p + 1;
+      // floor(q / p) by a multiplication, exact while q * p < 2^64.
+      const auto divide_p = [&](u64 q) -> u64 {
+        if constexpr(Fast) return (static_cast<u128>(q) * invp) >> 64;
+        else return q / p;
+      };
+      const u32 lim = n_ / p2 < sq ? n_ / p2 : sq, mid = sq / p < lim ? sq / p : lim;
+      for(u32 i = 1; i <= mid; ++i) large[i] -= fp * (large[i * p] - gp);
+      for(u32 i = mid + 1; i <= lim; ++i) large[i] -= fp * (small[divide_p(quot[i])] - gp);
+      if(p2 > sq) continue;
+      for(u32 w = sq / p; w >= p; --w) {
+        const T t = fp * (small[w] - gp);
+        const u32 first = w * p, last = first + p - 1 < sq ? first + p - 1 : sq;
+        for(u32 v = first; v <= last; ++v) small[v] -= t;
+      }
+    }
+  }
+  template<class U, class F> friend U MultiplicativePrefixSum(const PrimeSumTable<U>& g, F&& fpe);
+public:
+  constexpr PrimeSumTable() {}
+  template<class Prefix, class Value> PrimeSumTable(u64 N, Prefix&& prefix, Value&& value) : n_(N), sq(IntSqrt64(N)), small(sq + 1), large(sq + 1), primes_(EnumeratePrimes(sq)) {
+    for(u32 v = 1; v <= sq; ++v) small[v] = prefix(static_cast<u64>(v));
+    for(u32 i = 1; i <= sq; ++i) large[i] = prefix(N / i);
+    if(N < (1ull << 42)) sieve<true>(value);
+    else sieve<false>(value);
+  }
+  constexpr u64 n() const noexcept { return n_; }
+  // The primes up to sqrt(n).
+  constexpr const Vec<u32>& primes() const noexcept { return primes_; }
+  // The sum for v, which must be of the form floor(n / k).
+  constexpr T operator()(u64 v) const { return v <= sq ? small[v] : large[n_ / v]; }
+  constexpr PrimeSumTable& operator+=(const PrimeSumTable& x) {
+    for(u32 i = 0; i <= sq; ++i) small[i] += x.small[i], large[i] += x.large[i];
+    return *this;
+  }
+  constexpr PrimeSumTable& operator-=(const PrimeSumTable& x) {
+    for(u32 i = 0; i <= sq; ++i) small[i] -= x.small[i], large[i] -= x.large[i];
+    return *this;
+  }
+  constexpr PrimeSumTable& operator*=(const T& c) {
+    for(u32 i = 0; i <= sq; ++i) small[i] *= c, large[i] *= c;
+    return *this;
+  }
+};
+// The sum of the primes up to N.
+inline u128 SumPrimes(u64 N) {
+  if(N < 2) return 0;
+  return PrimeSumTable<u128>(N, [](u64 v) { return static_cast<u128>(v) * (v + 1) / 2 - 1; }, [](u64 p) { return static_cast<u128>(p); })(N);
+}
+// The table of sums of p^k over primes for a modint T. The prefix sums of n^k are interpolated from k + 2 points, so the modulus must be a prime larger than k + 1.
+template<class T> PrimeSumTable<T> PrimePowerSumTable(u64 N, u32 k) {
+  Vec<T> y(k + 2), fact_inv(k + 2);
+  for(u32 i = 1; i != k + 2; ++i) y[i] = y[i - 1] + T(i).pow(k);
+  fact_inv[k + 1] = T(1);
+  for(u32 i = 1; i != k + 2; ++i) fact_inv[k + 1] *= T(i);
+  fact_inv[k + 1] = fact_inv[k + 1].inv();
+  for(u32 i = k + 1; i != 0; --i) fact_inv[i - 1] = fact_inv[i] * T(i);
+  // coef[i] = y[i] / prod_{j != i} (i - j), so that prefix(v) = sum_i coef[i] prod_{j != i} (v - j).
+  Vec<T> coef(k + 2), suf(k + 3);
+  for(u32 i = 0; i != k + 2; ++i) coef[i] = (k + 1 - i) % 2 == 0 ? y[i] * fact_inv[i] * fact_inv[k + 1 - i] : -(y[i] * fact_inv[i] * fact_inv[k + 1 - i]);
+  const auto prefix = [&](u64 v) -> T {
+    if(v < k + 2) return y[v] - T(1);
+    const T x = v;
+    suf[k + 2] = T(1);
+    for(u32 i = k + 2; i != 0; --i) suf[i - 1] = suf[i] * (x - T(i - 1));
+    T res = 0, pre = 1;
+    for(u32 i = 0; i != k + 2; ++i) res += coef[i] * pre * suf[i + 1], pre *= x - T(i);
+    return res - T(1);
+  };
+  return PrimeSumTable<T>(N, prefix, [&](u64 p) { return T(p).pow(k); });
+}
+// The sum of f(n) for 1 <= n <= N of a multiplicative f by the second phase of Min_25's sieve, run as a sieve over the same floor(N / k) values in O(N^(3/4) / log N). g must hold the sums of f(p) over primes, usually built as a combination of PrimeSumTable, and fpe(p, e) must return f(p^e).
+template<class T, class F> T MultiplicativePrefixSum(const PrimeSumTable<T>& g, F&& fpe) {
+  const u64 N = g.n_;
+  if(N == 0) return T(0);
+  const u32 sq = g.sq;
+  // small[v] and large[i] hold the sums of f(x) for 2 <= x <= v (v = N / i for large) over the x that are prime or have no prime factor up to the current p.
+  Vec<T> small = g.small, large = g.large, fe;
+  Vec<u64> quot(sq + 1);
+  for(u32 i = 1; i <= sq; ++i) quot[i] = N / i;
+  for(u32 k = g.primes_.size(); k-- != 0;) {
+    const u64 p = g.primes_[k], p2 = p * p;
+    const T gp = g.small[p];
+    fe.clear();
+    fe.push_back(T(1));
+    for(u64 pe = 1; pe <= N / p; pe *= p) fe.push_back(fpe(p, fe.size()));
+    // floor(v / p^e) = floor(floor(v / p^(e - 1)) / p), and the divisions are done by multiplication as in PrimeSumTable.
+    const u64 invp = 0xffffffffffffffffu / p + 1;
+    const bool fast = N < (1ull << 42);
+    const auto divide_p = [&](u64 q) -> u64 { return fast ? static_cast<u64>((static_cast<u128>(q) * invp) >> 64) : q / p; };
+    const u32 lim = N / p2 < sq ? N / p2 : sq;
+    for(u32 i = 1; i <= lim; ++i) {
+      T acc = 0;
+      u64 q = divide_p(quot[i]), pe = p;
+      for(u32 e = 1; q >= p; ++e, pe *= p, q = divide_p(q)) acc += fe[e] * ((i * pe <= sq ? large[i * pe] : small[q]) - gp) + fe[e + 1];
+      large[i] += acc;
+    }
+    if(p2 > sq) continue;
+    // Every v in [w p, w p + p) shares floor(v / p^e) = floor(w / p^(e - 1)).
+    for(u32 w = sq / p; w >= p; --w) {
+      T acc = 0;
+      for(u32 e = 1, q = w; q >= p; ++e, q /= p) acc += fe[e] * (small[q] - gp) + fe[e + 1];
+      const u32 first = w * p, last = first + p - 1 < sq ? first + p - 1 : sq;
+      for(u32 v = first; v <= last; ++v) small[v] += acc;
+    }
+  }
+  return large[1] + T(1);
+}
 namespace internal {
 inline u16 TinyPrimes[6542] = {};
 inline u64 InvPrimes[6542] = {};
+// A nontrivial factor of an odd composite x by Pollard's rho with Brent's cycle detection. The differences are multiplied together in Montgomery form and a gcd is taken once per 128 steps, backtracking from the last block when the product collapses to 0.
 inline u64 FindFactor(u64 x) {
-  MontgomeryModint64Impl mint;
-  mint.set(x);
+  const Montgomery64 mg(x);
   static Rand64 engine;
-  constexpr u32 repeat = 8192;
-retry:
-  u64 r = mint.raw(engine() % (x - 1) + 1), a, b = mint.raw(engine() % (x - 1) + 1);
-  u32 k = repeat;
+  constexpr u64 block = 128;
   while(true) {
-    for(u32 i = k + 1; --i;) b = mint.fma(b, b, r);
-    a = b;
-    for(u32 i = 0; i < k; i += repeat) {
-      u64 mul = mint.one(), prev = b;
-      for(u32 j = repeat + 1; --j;) {
-        b = mint.fma(b, b, r);
-        mul = mint.mul(mul, mint.sub(a, b));
+    const u64 c = engine() % (x - 1) + 1;
+    const auto f = [&](u64 y) { return mg.add(mg.mul(y, y), c); };
+    u64 y = engine() % x, z = y, ys = y, q = mg.one(), g = 1;
+    for(u64 r = 1; g == 1; r *= 2) {
+      z = y;
+      for(u64 i = 0; i != r; ++i) y = f(y);
+      for(u64 k = 0; k < r && g == 1; k += block) {
+        ys = y;
+        for(u64 i = 0, e = r - k < block ? r - k : block; i != e; ++i) y = f(y), q = mg.mul(q, mg.sub(z, y));
+        g = GCD(q, x);
       }
-      u64 g = GCD(mint.val(mul), x);
-      if(g == x) {
-        mul = mint.one();
-        do {
-          prev = mint.fma(prev, prev, r);
-          mul = mint.mul(mul, mint.sub(a, prev));
-          g = GCD(mint.val(mul), x);
-        } while(g == 1);
-        if(g == x) goto retry;
+    }
+    if(g == x) {
+      do ys = f(ys), g = GCD(mg.sub(z, ys), x);
+      while(g == 1);
+    }
+    if(g != x) return g;
+  }
+}
+// FindFactor on many composites at once: each of L lanes runs its own rho sequence, all lanes advancing 128 steps in lockstep so that their multiplications overlap. The schedule starts at r = 128 so that every step of a block is used, and a lane that has found its factor takes the next composite right away.
+template<u32 L> void FindFactorLanes(const Vec<u64>& comp, Vec<u64>& factor) {
+  static Rand64 engine;
+  constexpr u64 block = 128;
+  Montgomery64 mg[L];
+  u64 c[L] = {}, y[L] = {}, z[L] = {}, ys[L] = {}, q[L] = {}, r[L] = {}, k[L] = {};
+  u32 id[L] = {};
+  bool acc[L] = {}, busy[L] = {};
+  u32 next = 0, running = 0;
+  factor.resize(comp.size());
+  const auto start = [&](u32 l) {
+    const u64 n = mg[l].n;
+    c[l] = engine() % (n - 1) + 1, y[l] = engine() % n, z[l] = y[l], q[l] = mg[l].one(), r[l] = block, k[l] = 0, acc[l] = false;
+  };
+  for(u32 l = 0; l != L; ++l) {
+    mg[l] = Montgomery64(3);
+    if(next != comp.size()) mg[l] = Montgomery64(comp[next]), id[l] = next++, busy[l] = true, ++running;
+    start(l);
+  }
+  while(running != 0) {
+    for(u32 l = 0; l != L; ++l) ys[l] = y[l];
+    for(u32 i = 0; i != block; ++i) {
+      GSH_INTERNAL_UNROLL(8)
+      for(u32 l = 0; l != L; ++l) {
+        y[l] = mg[l].add(mg[l].mul(y[l], y[l]), c[l]);
+        const u64 t = mg[l].mul(q[l], mg[l].sub(z[l], y[l]));
+        q[l] = acc[l] ? t : q[l];
       }
-      if(g != 1) return g;
     }
-    k *= 2;
+    for(u32 l = 0; l != L; ++l) {
+      if(!busy[l]) continue;
+      k[l] += block;
+      if(!acc[l]) {
+        if(k[l] == r[l]) acc[l] = true, k[l] = 0;
+        continue;
+      }
+      const u64 n = mg[l].n;
+      u64 g = GCD(q[l], n);
+      if(g == 1) {
+        if(k[l] == r[l]) acc[l] = false, k[l] = 0, r[l] *= 2, z[l] = y[l];
+        continue;
+      }
+      if(g == n) {
+        u64 w = ys[l];
+        do w = mg[l].add(mg[l].mul(w, w), c[l]), g = GCD(mg[l].sub(z[l], w), n);
+        while(g == 1);
+        if(g == n) {
+          start(l);
+          continue;
+        }
+      }
+      factor[id[l]] = g;
+      if(next != comp.size()) {
+        mg[l] = Montgomery64(comp[next]), id[l] = next++;
+        start(l);
+      } else busy[l] = false, acc[l] = false, --running;
+    }
   }
 }
 inline u64* FactorizeSub64(u64 n, u64* res) noexcept {
@@ -375,12 +1046,8 @@ inline u64* FactorizeSub64(u64 n, u64* res) noexcept {
     return res;
   } else return FactorizeSub64(m, res);
 }
-}
-inline auto Factorize(u64 n) {
-  thread_local u64 res[64];
-  if(n <= 1) [[unlikely]]
-    return Subrange(res, res);
-  u64* p = res;
+// Divides 2 to 19 out of n != 0, writing each factor from p on, and returns the end of what was written.
+GSH_INTERNAL_INLINE inline u64* FactorizeTiny(u64& n, u64* p) noexcept {
   {
     Assume(n != 0);
     u32 rz = std::countr_zero(n);
@@ -432,6 +1099,14 @@ inline auto Factorize(u64 n) {
       } while(n % 19 == 0);
     }
   }
+  return p;
+}
+}
+inline auto Factorize(u64 n) {
+  thread_local u64 res[64];
+  if(n <= 1) [[unlikely]]
+    return Subrange(res, res);
+  u64* p = internal::FactorizeTiny(n, res);
   if(n >= 529) [[likely]] {
     p = internal::FactorizeSub64(n, p);
   } else {
@@ -440,4 +1115,97 @@ inline auto Factorize(u64 n) {
   }
   return Subrange(res, p);
 }
+namespace internal {
+// The primes from 23 to 997 with their inverses modulo 2^64: p divides n exactly when n * inv is at most lim = (2^64 - 1) / p, and then n * inv is the quotient.
+struct TrialDivisorTable {
+  u64 inv[160] = {}, lim[160] = {};
+  u32 p[160] = {};
+};
+constexpr TrialDivisorTable TrialDivisors = [] {
+  TrialDivisorTable t;
+  for(u32 p = 23, k = 0; k != 160; p += 2) {
+    if(!IsPrime(p)) continue;
+    u64 inv = p;
+    for(u32 i = 0; i != 5; ++i) inv *= 2 - p * inv;
+    t.inv[k] = inv, t.lim[k] = 0xffffffffffffffff / p, t.p[k++] = p;
+  }
+  return t;
+}();
+}
+// The prime factors of the elements passed to FactorizeBatch in one flat array: res[i] is the range of those of x[i].
+class FactorizeBatchResult {
+  Vec<u64> factors_;
+  Vec<u32> start_;
+public:
+  constexpr FactorizeBatchResult(Vec<u64>&& factors, Vec<u32>&& start) : factors_(std::move(factors)), start_(std::move(start)) {}
+  constexpr u32 size() const noexcept { return start_.size() - 1; }
+  constexpr auto operator[](u32 i) const noexcept { return Subrange(factors_.data() + start_[i], factors_.data() + start_[i + 1]); }
+};
+// The prime factors of every x[i] with multiplicity, each in increasing order.
+// Each element is handled as in Factorize until its cofactor turns out to be a composite above 2^32. Such a cofactor is trial divided by the primes below 1000, which rho would need hundreds of lockstep steps for, and what remains composite is split by FindFactorLanes, repeating until only primes remain. Only the elements that went through rho are sorted.
+inline FactorizeBatchResult FactorizeBatch(std::span<const u64> x) {
+  const auto& td = internal::TrialDivisors;
+  Vec<u64> fac, cur, next, factor, extra;
+  Vec<u32> start(x.size() + 1), owner, next_owner, extra_owner;
+  u64 buf[64];
+  u32 used = 0;
+  fac.resize(4 * x.size() + 64);
+  for(u32 i = 0; i != x.size(); ++i) {
+    // A u64 has at most 63 prime factors.
+    if(fac.size() < used + 64) fac.resize(2 * fac.size());
+    u64 n = x[i], *p = fac.data() + used;
+    if(n > 1) {
+      p = internal::FactorizeTiny(n, p);
+      if(n < 529) {
+        *p = n;
+        p += n != 1;
+      } else if(n <= 0xffffffff) p = internal::FactorizeSub64(n, p);
+      else if(IsPrime(n)) *(p++) = n;
+      else {
+        for(u32 k = 0; k != 160; ++k) {
+          const u64 inv = td.inv[k], lim = td.lim[k];
+          if(n * inv <= lim) [[unlikely]] {
+            do n *= inv, *(p++) = td.p[k];
+            while(n * inv <= lim);
+          }
+        }
+        if(n <= 0xffffffff) {
+          if(n != 1) p = internal::FactorizeSub64(n, p);
+        } else if(IsPrime(n)) *(p++) = n;
+        else cur.push_back(n), owner.push_back(i);
+      }
+    }
+    start[i + 1] = used = p - fac.data();
+  }
+  fac.resize(used);
+  while(!cur.empty()) {
+    internal::FindFactorLanes<8>(cur, factor);
+    next.clear(), next_owner.clear();
+    for(u32 j = 0; j != cur.size(); ++j) {
+      for(const u64 v : {factor[j], cur[j] / factor[j]}) {
+        if(v <= 0xffffffff) {
+          u64* const e = internal::FactorizeSub64(v, buf);
+          extra.insert(extra.end(), buf, e), extra_owner.insert(extra_owner.end(), e - buf, owner[j]);
+        } else if(IsPrime(v)) extra.push_back(v), extra_owner.push_back(owner[j]);
+        else next.push_back(v), next_owner.push_back(owner[j]);
+      }
+    }
+    cur.swap(next), owner.swap(next_owner);
+  }
+  if(extra.empty()) return FactorizeBatchResult(std::move(fac), std::move(start));
+  Vec<u32> add(x.size()), start2(x.size() + 1);
+  for(const u32 i : extra_owner) ++add[i];
+  for(u32 i = 0; i != x.size(); ++i) start2[i + 1] = start2[i] + (start[i + 1] - start[i]) + add[i];
+  Vec<u64> fac2(fac.size() + extra.size());
+  for(u32 i = 0; i != x.size(); ++i) {
+    const u32 len = start[i + 1] - start[i];
+    MemoryCopy(fac2.data() + start2[i], fac.data() + start[i], len * sizeof(u64));
+    add[i] = start2[i] + len;
+  }
+  for(u32 j = 0; j != extra.size(); ++j) fac2[add[extra_owner[j]]++] = extra[j];
+  for(u32 i = 0; i != x.size(); ++i) {
+    if(start2[i + 1] - start2[i] != start[i + 1] - start[i]) Subrange(fac2.data() + start2[i], fac2.data() + start2[i + 1]).sort();
+  }
+  return FactorizeBatchResult(std::move(fac2), std::move(start2));
+}
 }
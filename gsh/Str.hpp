@@ -58,6 +58,23 @@ public:
     return res;
   }
 };
+// Returns views into the input buffer without copying. Only usable with streams whose buffer is never overwritten (stable_buffer), such as MmapReader and StaticStrReader.
+template<> class Parser<StrView> {
+public:
+  template<class Stream> requires std::remove_cvref_t<Stream>::stable_buffer constexpr StrView operator()(Stream&& stream) const {
+    const c8* s = stream.current();
+    const u32 avail = stream.avail();
+    u32 len = 0;
+    while(len != avail && s[len] >= '!') ++len;
+    stream.skip(len + (len != avail));
+    return StrView(s, len);
+  }
+  template<class Stream> requires std::remove_cvref_t<Stream>::stable_buffer constexpr StrView operator()(Stream&& stream, u32 n) const {
+    const c8* s = stream.current();
+    stream.skip(n + (n != stream.avail()));
+    return StrView(s, n);
+  }
+};
 template<class T> class Formatter;
 template<> class Formatter<StrView> {
 public:
@@ -14,6 +14,19 @@ namespace gsh {
   [[maybe_unused]] u32 n = 1 / 0;
 #endif
 };
+#if defined(__GNUC__) && defined(__x86_64__)
+namespace internal {
+// Runtime check guarding the code paths compiled with __attribute__((target("avx2"))).
+inline bool HasAVX2() {
+  static const bool res = __builtin_cpu_supports("avx2");
+  return res;
+}
+inline bool HasAVX512IFMA() {
+  static const bool res = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma");
+  return res;
+}
+}
+#endif
 GSH_INTERNAL_INLINE constexpr void Assume(const bool f) {
   if(std::is_constant_evaluated()) return;
 #if defined __clang__
@@ -138,6 +151,7 @@ GSH_INTERNAL_INLINE constexpr u32 StrLen(const c8* p) {
   } else return std::strlen(p);
 }
 namespace internal {
+inline constexpr u64 Pow10Table[20] = {1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull};
 template<u32 N, class First, class... Tail> class TypeAtImpl : public TypeAtImpl<N - 1, Tail...> {};
 template<class T, class... Types> class TypeAtImpl<0, T, Types...> {
 public: